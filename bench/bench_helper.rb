@@ -0,0 +1,76 @@
+require 'json'
+require_relative '../lib/actuator'
+require_relative '../lib/actuator/mutex'
+
+module Actuator
+  # Minimal benchmark runner which executes each registered benchmark inside a job on a running reactor.
+  #
+  # Results are written as JSON so that they can be compared against a stored baseline.
+  module Bench
+    # Regressions are only flagged once throughput drops by more than this fraction
+    DEFAULT_TOLERANCE = 0.15
+
+    @benchmarks = []
+
+    class << self
+      attr_reader :benchmarks
+
+      # The block receives the number of ops to perform and may yield the current job until they complete.
+      # Warm up defaults to 1% of the ops, benchmarks which grow pools should warm up with the full amount.
+      def register(name, ops, warmup: nil, &block)
+        @benchmarks << [name, ops, warmup || [ops / 100, 1].max, block]
+      end
+
+      def run(filter=nil, scale=1.0)
+        results = []
+        Log.file_path = nil
+        Actuator.run do
+          @benchmarks.each do |name, ops, warmup, block|
+            next if filter && name !~ filter
+            ops = [(ops * scale).to_i, 1].max
+            warmup = [(warmup * scale).to_i, 1].max
+            results << measure(name, ops, warmup, &block)
+            Kernel.puts format_result(results.last)
+          end
+          Actuator.stop
+        end
+        Log.file_path = :stdout
+        results
+      end
+
+      def measure(name, ops, warmup)
+        # Warm up so that lazily initialized state doesn't skew the first sample
+        yield warmup
+        GC.start
+        allocated_before = GC.stat(:total_allocated_objects)
+        started_at = Actuator.now
+        yield ops
+        elapsed = Actuator.now - started_at
+        allocated = GC.stat(:total_allocated_objects) - allocated_before
+        { 'name' => name, 'ops' => ops, 'seconds' => elapsed.round(6), 'ops_per_sec' => (ops / elapsed).round(1), 'allocations_per_op' => (allocated.to_f / ops).round(2) }
+      end
+
+      def format_result(result)
+        '%-32s %12.1f ops/s %8.2f allocs/op' % result.values_at('name', 'ops_per_sec', 'allocations_per_op')
+      end
+
+      def write(path, results)
+        File.write(path, JSON.pretty_generate(results.map { |result| [result['name'], result] }.to_h))
+      end
+
+      def load(path)
+        JSON.parse(File.read(path))
+      end
+
+      # Returns a message for each benchmark which is slower than the baseline by more than the tolerance
+      def compare(results, baseline, tolerance=DEFAULT_TOLERANCE)
+        results.each_with_object([]) do |result, regressions|
+          next unless expected = baseline[result['name']]
+          change = result['ops_per_sec'] / expected['ops_per_sec'] - 1.0
+          next if change >= -tolerance
+          regressions << '%s: %.1f ops/s is %.1f%% slower than baseline (%.1f ops/s)' % [result['name'], result['ops_per_sec'], -change * 100, expected['ops_per_sec']]
+        end
+      end
+    end
+  end
+end
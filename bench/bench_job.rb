@@ -0,0 +1,58 @@
+require_relative 'bench_helper'
+
+module Actuator
+  Bench.register 'defer_spawn', 100_000 do |ops|
+    ops.times { Actuator.defer {} }
+  end
+
+  Bench.register 'job_sleep_zero', 50_000 do |ops|
+    ops.times { Job.sleep 0 }
+  end
+
+  # Same as job_sleep_zero with the stall watchdog bumping its heartbeat on every fiber switch
+  if Actuator.stats[:watchdog][:supported]
+    Bench.register 'job_sleep_zero_watchdog', 50_000 do |ops|
+      Actuator.stall_threshold = 1
+      begin
+        ops.times { Job.sleep 0 }
+      ensure
+        Actuator.stall_threshold = nil
+      end
+    end
+  end
+
+  # Fan-out/fan-in of 10k jobs which each suspend once, compared to joining every job in join_fanout.
+  # Warming up with every job grows the fiber pool so that neither benchmark includes creating fibers.
+  Bench.register 'job_group_fanout', 10_000, warmup: 10_000 do |ops|
+    group = JobGroup.new
+    ops.times { group.defer { Job.sleep 0 } }
+    group.wait_all
+  end
+
+  Bench.register 'join_fanout', 10_000, warmup: 10_000 do |ops|
+    jobs = Array.new(ops) { Actuator.defer { Job.sleep 0 } }
+    jobs.each(&:join)
+  end
+
+  # Round trip of an empty block through a worker thread and the posted completion queue
+  Bench.register 'job_offload', 5_000 do |ops|
+    ops.times { Job.offload {} }
+  end
+
+  # Each job sleeps while holding the lock so that every unlock hands the mutex over to the other job
+  Bench.register 'mutex_handoff', 20_000 do |ops|
+    mutex = Mutex.new
+    handoffs = 0
+    jobs = Array.new(2) do
+      Actuator.defer do
+        while handoffs < ops
+          mutex.synchronize do
+            handoffs += 1
+            Job.sleep 0
+          end
+        end
+      end
+    end
+    jobs.each(&:join)
+  end
+end
@@ -0,0 +1,9 @@
+require_relative 'bench_helper'
+
+module Actuator
+  Bench.register 'log_puts', 200_000 do |ops|
+    Log.file_path = File::NULL
+    ops.times { Log.puts 'benchmark message' }
+    Log.file_path = nil
+  end
+end
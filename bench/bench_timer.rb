@@ -0,0 +1,87 @@
+require_relative 'bench_helper'
+
+module Actuator
+  Bench.register 'timer_in_destroy', 200_000 do |ops|
+    ops.times { Timer.in(1) {}.destroy }
+  end
+
+  # Idle timeout refreshed on every packet, compared to destroying and recreating the timer in timer_in_destroy
+  Bench.register 'timer_reschedule', 200_000 do |ops|
+    timer = Timer.in(1) {}
+    ops.times { timer.reschedule(1) }
+    timer.destroy
+  end
+
+  # Every expiring timer is unregistered from the GC root list which is currently linear in the number of roots
+  Bench.register 'timer_update_expiring', 20_000 do |ops|
+    job = Job.current
+    remaining = ops
+    ops.times do
+      Timer.in(0) { job.fiber.resume if (remaining -= 1) == 0 }
+    end
+    Job.yield
+  end
+
+  Bench.register 'timer_after_cancel', 200_000 do |ops|
+    ops.times { Timer.cancel(Timer.after(1) {}) }
+  end
+
+  Bench.register 'timer_after_expiring', 200_000 do |ops|
+    job = Job.current
+    remaining = ops
+    ops.times do
+      Timer.after(0) { job.fiber.resume if (remaining -= 1) == 0 }
+    end
+    Job.yield
+  end
+
+  # Firing cost of a method call timer compared to the equivalent block in timer_after_expiring
+  class CallTarget
+    def initialize(job, remaining)
+      @job = job
+      @remaining = remaining
+    end
+
+    def on_timeout(_)
+      @job.fiber.resume if (@remaining -= 1) == 0
+    end
+  end
+
+  Bench.register 'timer_call_in_expiring', 200_000 do |ops|
+    target = CallTarget.new(Job.current, ops)
+    ops.times { Timer.call_in(0, target, :on_timeout, ops) }
+    Job.yield
+  end
+
+  Bench.register 'interval_fanout', 200_000 do |ops|
+    job = Job.current
+    remaining = ops
+    timers = Array.new(1000) do
+      Timer.every(0.0001) { job.fiber.resume if (remaining -= 1) == 0 }
+    end
+    Job.yield
+    timers.each(&:destroy)
+  end
+
+  # Heartbeat churn, compared to creating and destroying individually scheduled interval timers
+  Bench.register 'timer_group_churn', 200_000 do |ops|
+    group = TimerGroup.new(5)
+    ops.times { group.every {}.destroy }
+  end
+
+  Bench.register 'timer_every_churn', 200_000 do |ops|
+    ops.times { Timer.every(5) {}.destroy }
+  end
+
+  # Same population as interval_fanout, the group fires one bucket per tick instead of scheduling each member
+  Bench.register 'timer_group_fanout', 200_000 do |ops|
+    job = Job.current
+    remaining = ops
+    group = TimerGroup.new(0.0001)
+    timers = Array.new(1000) do
+      group.every { job.fiber.resume if (remaining -= 1) == 0 }
+    end
+    Job.yield
+    timers.each(&:destroy)
+  end
+end
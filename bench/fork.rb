@@ -0,0 +1,89 @@
+# Measures aggregate timer throughput of pre-forked reactors, one per worker process.
+#
+# Each worker is forked with Actuator.fork_workers (pinned to its own CPU unless --no_affinity is given) and keeps
+# --timers timers re-arming themselves with random sub-millisecond delays for --duration seconds.
+#
+#   ruby bench/fork.rb [--workers=1,2,4] [--duration=2] [--timers=1000] [--no_affinity] [--output=path]
+#
+# Worker counts default to powers of two up to the number of CPUs.
+
+require 'json'
+require 'etc'
+require_relative '../lib/actuator'
+
+module Actuator
+  module ForkBench
+    DEFAULTS = { 'duration' => 2.0, 'timers' => 1000 }
+
+    class << self
+      def run(worker_counts, options)
+        results = []
+        worker_counts.each do |count|
+          results << measure(count, options)
+          # Scaling is relative to the first worker count, which is a single worker by default
+          results.last['scaling'] = (results.last['ops_per_second'].to_f / results.first['ops_per_second']).round(2)
+          Kernel.puts format_result(results.last)
+        end
+        results
+      end
+
+      def measure(count, options)
+        reader, writer = IO.pipe
+        pids = Actuator.fork_workers(count, affinity: !options['no_affinity']) do |index|
+          reader.close
+          writer.write Marshal.dump(work(options))
+          exit!
+        end
+        writer.close
+        fires = Array.new(count) { Marshal.load(reader) }
+        pids.each { |pid| Process.wait pid }
+        reader.close
+        total = fires.sum
+        {
+          'workers' => count,
+          'fires' => total,
+          'ops_per_second' => (total / options['duration']).to_i,
+          'per_worker' => (total / options['duration'] / count).to_i
+        }
+      end
+
+      def work(options)
+        fires = 0
+        Actuator.run do
+          started_at = Actuator.now
+          stop_at = started_at + options['duration']
+          options['timers'].times do
+            rearm = proc do
+              fires += 1
+              Timer.in(rand * 0.001, &rearm) if Actuator.now < stop_at
+            end
+            Timer.in(rand * 0.001, &rearm)
+          end
+          Timer.in(options['duration'] + 0.01) { Actuator.stop }
+        end
+        fires
+      end
+
+      def format_result(result)
+        '%3d workers  fires: %10d  %10d ops/s  %10d ops/s per worker  scaling: %5.2fx' %
+          result.values_at('workers', 'fires', 'ops_per_second', 'per_worker', 'scaling')
+      end
+    end
+  end
+end
+
+if $0 == __FILE__
+  options = Actuator::ForkBench::DEFAULTS.dup
+  ARGV.select { |arg| arg.start_with? '--' }.each do |arg|
+    key, value = arg[2..-1].split('=', 2)
+    options[key] = value.nil? ? true : value =~ /\A[\d.]+\z/ ? (value.include?('.') ? value.to_f : value.to_i) : value
+  end
+  options['duration'] = options['duration'].to_f
+  counts = options['workers'] ? options['workers'].to_s.split(',').map(&:to_i) : []
+  if counts.empty?
+    counts = [1]
+    counts << counts.last * 2 while counts.last * 2 <= Etc.nprocessors
+  end
+  results = Actuator::ForkBench.run(counts, options)
+  File.write(options['output'], JSON.pretty_generate(results)) if options['output']
+end
@@ -0,0 +1,249 @@
+# Characterizes timer lateness under synthetic load, similar to cyclictest.
+#
+# Lateness is recorded natively inside Timer::Fire for every timer which fires while a scenario is running.
+#
+#   ruby bench/jitter.rb [scenario...] [--duration=5] [--interval=0.001] [--threads=2] [--timers=10000] [--output=path]
+#
+# Real-time tuning of the reactor thread can be applied to show its effect on lateness:
+#
+#   --realtime  Shorthand for pinning to the last CPU with SCHED_FIFO, mlock and a prefaulted stack
+#   --cpus=0,1 --scheduler=fifo --priority=50 --mlock --prefault_stack=524288
+#
+# GC work can be moved into idle gaps with --idle_gc=0.0005 (see Actuator.idle_gc_headroom).
+#
+# Expiry storms can be measured against a prioritized probe with --priority=high --tick_budget_us=500.
+
+require 'json'
+require 'rbconfig'
+require 'tmpdir'
+require 'etc'
+require_relative '../lib/actuator'
+
+module Actuator
+  module Jitter
+    DEFAULTS = { 'duration' => 5.0, 'interval' => 0.001, 'threads' => 2, 'timers' => 10_000 }
+    REALTIME_OPTIONS = %w(cpus scheduler priority mlock prefault_stack)
+
+    @scenarios = {}
+
+    class << self
+      attr_reader :scenarios
+
+      # The block starts the load and returns a proc which stops it
+      def scenario(name, description, &block)
+        @scenarios[name] = [description, block]
+      end
+
+      def realtime_options(options)
+        if options['realtime']
+          options = { 'cpus' => [Etc.nprocessors - 1], 'scheduler' => :fifo, 'mlock' => true, 'prefault_stack' => true }.merge(options)
+        end
+        realtime = options.select { |key, _| REALTIME_OPTIONS.include? key }.map { |key, value| [key.to_sym, value] }.to_h
+        realtime[:cpus] = realtime[:cpus].to_s.split(',').map(&:to_i) if realtime[:cpus].is_a? String
+        realtime[:scheduler] = realtime[:scheduler].to_sym if realtime[:scheduler]
+        realtime
+      end
+
+      # Burners are spawned suspended before the reactor starts so that they don't inherit its CPU affinity
+      def spawn_burners
+        @burners = Array.new(Etc.nprocessors) { Process.spawn(RbConfig.ruby, '-e', 'Process.kill(:STOP, Process.pid); loop {}') }
+      end
+
+      def burners
+        @burners || Array.new(Etc.nprocessors) { Process.spawn(RbConfig.ruby, '-e', 'loop {}') }
+      end
+
+      def kill_burners
+        return unless @burners
+        @burners.each { |pid| Process.kill(:KILL, pid); Process.wait(pid) }
+        @burners = nil
+      end
+
+      def run(names, options)
+        results = []
+        spawn_burners if names.include?('cpu') && Signal.list['STOP']
+        Actuator.run(realtime_options(options)) do
+          Actuator.idle_gc_headroom = options['idle_gc'] if options['idle_gc']
+          Timer.tick_budget_us = options['tick_budget_us'] if options['tick_budget_us']
+          realtime = Actuator.stats[:realtime].reject { |_, result| result == :not_requested }
+          Kernel.puts "Real-time tuning: #{realtime.map { |key, result| "#{key} #{result}" }.join ', '}" unless realtime.empty?
+          names.each do |name|
+            results << measure(name, options)
+            Kernel.puts format_result(results.last)
+          end
+          Actuator.stop
+        end
+        results
+      ensure
+        kill_burners
+      end
+
+      def measure(name, options)
+        description, block = @scenarios.fetch(name)
+        stop_load = block.(options)
+        probe_lateness = []
+        probe_at = nil
+        probe = Timer.every(options['interval'], options['priority'] && options['priority'].to_sym) do
+          now = Actuator.now
+          probe_lateness << ((now - probe_at - options['interval']) * 1_000_000).to_i if probe_at
+          probe_at = now
+        end
+        # Give the load time to ramp up before sampling
+        Job.sleep 0.25
+        Timer.reset_lateness
+        probe_lateness.clear
+        gc_before = Actuator.stats[:gc]
+        Job.sleep options['duration']
+        lateness = Timer.lateness
+        gc_after = Actuator.stats[:gc]
+        probe.destroy
+        stop_load.()
+        result = { 'scenario' => name, 'description' => description }.merge(lateness.map { |key, value| [key.to_s, value] }.to_h)
+        %i(pauses pause_us_total late_fires late_us_total idle_runs).each { |key| result["gc_#{key}"] = gc_after[key] - gc_before[key] }
+        # Lateness of every timer is recorded natively, the probe is also sampled separately since it may be prioritized
+        probe_lateness.sort!
+        result['probe_p99'] = probe_lateness[(probe_lateness.size * 0.99).to_i] || 0
+        result['probe_max'] = probe_lateness.last || 0
+        result
+      end
+
+      def format_result(result)
+        '%-8s fires: %8d  p50: %6d us  p99: %6d us  p99.9: %6d us  max: %7d us  probe p99: %6d us  max: %7d us  GC late: %6d fires %8d us' %
+          result.values_at('scenario', 'count', 'p50', 'p99', 'p999', 'max', 'probe_p99', 'probe_max', 'gc_late_fires', 'gc_late_us_total')
+      end
+    end
+
+    scenario 'idle', 'Probe timer only' do
+      -> {}
+    end
+
+    scenario 'cpu', 'Processes burning every core' do |options|
+      if Signal.list['STOP']
+        burners.each { |pid| Process.kill(:CONT, pid) }
+        -> { burners.each { |pid| Process.kill(:STOP, pid) } }
+      else
+        pids = burners
+        -> { pids.each { |pid| Process.kill(:KILL, pid); Process.wait(pid) } }
+      end
+    end
+
+    scenario 'gvl', 'Ruby threads contending for the GVL' do |options|
+      threads = Array.new(options['threads']) { Thread.new { loop {} } }
+      -> { threads.each(&:kill) }
+    end
+
+    scenario 'gc', 'Jobs allocating heavily between yields' do |options|
+      running = true
+      jobs = Array.new(options['threads']) do
+        Actuator.defer do
+          while running
+            Array.new(1000) { 'x' * 64 }
+            Job.sleep 0
+          end
+        end
+      end
+      -> do
+        running = false
+        jobs.each(&:join)
+      end
+    end
+
+    scenario 'timers', 'Many concurrent timers with random delays' do |options|
+      timers = Array.new(options['timers']) do
+        Timer.every(options['interval'] * (1 + rand * 100)) {}
+      end
+      -> { timers.each(&:destroy) }
+    end
+
+    scenario 'storm', 'Bursts of low priority timers expiring in the same tick' do |options|
+      storm = Timer.every(0.02) do
+        500.times { Timer.in(0.01, :low) {} }
+      end
+      -> do
+        storm.destroy
+        Job.sleep 0.1
+      end
+    end
+
+    scenario 'every_work', 'Housekeeping in 500us chunks from a Timer.every callback' do |options|
+      housekeeping = Timer.every(0.003) do
+        started_at = Actuator.now
+        nil while Actuator.now < started_at + 0.0005
+      end
+      -> { housekeeping.destroy }
+    end
+
+    scenario 'idle_work', 'The same housekeeping run by a job which yields with Job.idle' do |options|
+      running = true
+      job = Actuator.defer do
+        while running
+          started_at = Actuator.now
+          nil while Actuator.now < started_at + 0.0005 && Actuator.idle_time_left > 0
+          Job.idle
+        end
+      end
+      -> do
+        running = false
+        job.join
+      end
+    end
+
+    scenario 'blocking', 'Jobs making 1ms blocking calls on the reactor thread' do |options|
+      running = true
+      jobs = Array.new(options['threads']) do
+        Actuator.defer do
+          while running
+            Kernel.sleep 0.001
+            Job.sleep 0.005
+          end
+        end
+      end
+      -> do
+        running = false
+        jobs.each(&:join)
+      end
+    end
+
+    scenario 'offload', 'The same blocking calls moved to worker threads with Job.offload' do |options|
+      running = true
+      jobs = Array.new(options['threads']) do
+        Actuator.defer do
+          while running
+            Job.offload { Kernel.sleep 0.001 }
+            Job.sleep 0.005
+          end
+        end
+      end
+      -> do
+        running = false
+        jobs.each(&:join)
+      end
+    end
+
+    scenario 'log', 'Callbacks which log heavily to a file' do |options|
+      path = File.join(Dir.tmpdir, "actuator_jitter_#{Process.pid}.log")
+      Log.file_path = path
+      message = 'x' * 200
+      timers = Array.new(100) do
+        Timer.every(options['interval']) { 10.times { Log.puts message } }
+      end
+      -> do
+        timers.each(&:destroy)
+        Log.file_path = :stdout
+        File.delete path
+      end
+    end
+  end
+end
+
+if $0 == __FILE__
+  options = Actuator::Jitter::DEFAULTS.dup
+  ARGV.select { |arg| arg.start_with? '--' }.each do |arg|
+    key, value = arg[2..-1].split('=', 2)
+    options[key] = value.nil? ? true : value =~ /\A[\d.]+\z/ ? (value.include?('.') ? value.to_f : value.to_i) : value
+  end
+  names = ARGV.reject { |arg| arg.start_with? '--' }
+  names = Actuator::Jitter.scenarios.keys if names.empty?
+  results = Actuator::Jitter.run(names, options)
+  File.write(options['output'], JSON.pretty_generate(results)) if options['output']
+end
@@ -0,0 +1,176 @@
+// Drives the timer scheduler directly from C++ so that scheduler overhead can be
+// measured without the cost of calling into ruby for every operation.
+//
+// Built and run by `rake bench:native`. Results are printed as one JSON object per line.
+//
+//   scheduler_bench [ops]                               Scheduler throughput
+//   scheduler_bench jitter [seconds] [burner_threads]   Lateness of a 1ms interval timer while native threads burn CPU
+
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <ruby.h>
+#include "reactor.h"
+#include "timer_pool.h"
+
+extern "C" void Init_actuator();
+
+static int fired_count = 0;
+
+static void count_fire(Timer *timer, void *data)
+{
+    fired_count++;
+}
+
+static void report(const char *name, long ops, double elapsed)
+{
+    printf("{\"name\":\"native/%s\",\"ops\":%ld,\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"allocations_per_op\":0}\n",
+        name, ops, elapsed, ops / elapsed);
+    fflush(stdout);
+}
+
+// Timer.in + Timer#destroy churn
+static void bench_churn(long ops)
+{
+    double started_at = clock_time();
+    for (long i = 0; i < ops; i++) {
+        Timer *timer = new Timer(1.0);
+        timer->SetNativeCallback(count_fire, 0);
+        timer->Schedule();
+        timer->Destroy();
+        delete timer;
+    }
+    report("timer_churn", ops, clock_time() - started_at);
+}
+
+// Timer.after + Timer.cancel churn using pooled timers
+static void bench_pooled_churn(long ops)
+{
+    double started_at = clock_time();
+    for (long i = 0; i < ops; i++) {
+        Timer *timer = TimerPool::Acquire(1.0);
+        timer->SetNativeCallback(count_fire, 0);
+        timer->Schedule();
+        timer->Destroy();
+    }
+    report("pooled_churn", ops, clock_time() - started_at);
+}
+
+// Timer::Update with a batch of timers that all expire in the same tick
+static void bench_expiring(long ops, long batch_size)
+{
+    std::vector<Timer*> timers;
+    timers.reserve(batch_size);
+    double elapsed = 0;
+    long total = 0;
+    while (total < ops) {
+        for (long i = 0; i < batch_size; i++) {
+            Timer *timer = new Timer(0);
+            timer->SetNativeCallback(count_fire, 0);
+            timer->Schedule();
+            timers.push_back(timer);
+        }
+        fired_count = 0;
+        double started_at = clock_time();
+        Timer::Update(clock_time());
+        elapsed += clock_time() - started_at;
+        if (fired_count != batch_size) {
+            fprintf(stderr, "Expected %ld timers to fire, only %d fired\n", batch_size, fired_count);
+            exit(1);
+        }
+        for (Timer *timer : timers) delete timer;
+        timers.clear();
+        total += batch_size;
+    }
+    report("timer_update_expiring", total, elapsed);
+}
+
+// Interval timers which all expire and get rescheduled every tick
+static void bench_interval_fanout(long ops, long timer_count)
+{
+    std::vector<Timer*> timers;
+    for (long i = 0; i < timer_count; i++) {
+        Timer *timer = new Timer(0);
+        timer->interval = 1e-9;
+        timer->SetNativeCallback(count_fire, 0);
+        timer->Schedule();
+        timers.push_back(timer);
+    }
+    fired_count = 0;
+    double started_at = clock_time();
+    while (fired_count < ops) Timer::Update(clock_time());
+    double elapsed = clock_time() - started_at;
+    long fired = fired_count;
+    for (Timer *timer : timers) {
+        timer->Destroy();
+        delete timer;
+    }
+    report("interval_fanout", fired, elapsed);
+}
+
+static Timer *jitter_probe;
+
+static void stop_jitter(Timer *timer, void *data)
+{
+    jitter_probe->Destroy();
+    actuator->Stop();
+}
+
+// Runs the reactor with a native probe timer so that the lateness floor can be measured without ruby callbacks
+static void bench_jitter(double duration, int burner_count)
+{
+    std::atomic<bool> burning(true);
+    std::vector<std::thread> burners;
+    for (int i = 0; i < burner_count; i++) {
+        burners.emplace_back([&burning]() {
+            volatile uint64_t spins = 0;
+            while (burning) spins++;
+        });
+    }
+
+    jitter_probe = new Timer(0.001);
+    jitter_probe->interval = 0.001;
+    jitter_probe->SetNativeCallback(count_fire, 0);
+    jitter_probe->Schedule();
+    Timer *stop_timer = new Timer(duration);
+    stop_timer->SetNativeCallback(stop_jitter, 0);
+    stop_timer->Schedule();
+
+    Timer::lateness.Reset();
+    actuator->Start();
+
+    burning = false;
+    for (std::thread &burner : burners) burner.join();
+    delete jitter_probe;
+    delete stop_timer;
+
+    Histogram &lateness = Timer::lateness;
+    printf("{\"scenario\":\"native\",\"burner_threads\":%d,\"count\":%llu,\"p50\":%lld,\"p99\":%lld,\"p999\":%lld,\"max\":%lld}\n",
+        burner_count, (unsigned long long)lateness.count, (long long)lateness.Percentile(50), (long long)lateness.Percentile(99),
+        (long long)lateness.Percentile(99.9), (long long)lateness.max);
+}
+
+int main(int argc, char **argv)
+{
+    ruby_init();
+    Init_actuator();
+    Log::log_file = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "jitter")) {
+        bench_jitter(argc > 2 ? atof(argv[2]) : 5.0, argc > 3 ? atoi(argv[3]) : 0);
+        return ruby_cleanup(0);
+    }
+
+    long ops = argc > 1 ? atol(argv[1]) : 1000000;
+    actuator->is_running = true;
+
+    bench_churn(ops);
+    bench_pooled_churn(ops);
+    bench_expiring(ops, 1000);
+    bench_interval_fanout(ops, 1000);
+
+    actuator->is_running = false;
+    return ruby_cleanup(0);
+}
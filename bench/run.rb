@@ -0,0 +1,25 @@
+# Runs the benchmark suite and optionally compares it against a stored baseline.
+#
+#   ruby bench/run.rb [filter] [--scale=0.1] [--native=harness] [--output=path] [--baseline=path] [--tolerance=0.15]
+
+require_relative 'bench_helper'
+Dir[File.join(__dir__, 'bench_*.rb')].sort.each { |path| require path }
+
+options = ARGV.select { |arg| arg.start_with? '--' }.map { |arg| arg[2..-1].split('=', 2) }.to_h
+filter = ARGV.find { |arg| !arg.start_with? '--' }
+
+results = Actuator::Bench.run(filter && Regexp.new(filter), (options['scale'] || 1.0).to_f)
+results.concat `#{options['native']}`.lines.map { |line| JSON.parse(line) } if options['native']
+
+Actuator::Bench.write(options['output'], results) if options['output']
+
+if options['baseline']
+  baseline = Actuator::Bench.load(options['baseline'])
+  regressions = Actuator::Bench.compare(results, baseline, (options['tolerance'] || Actuator::Bench::DEFAULT_TOLERANCE).to_f)
+  if regressions.empty?
+    Kernel.puts "No regressions compared to #{options['baseline']}"
+  else
+    Kernel.puts "Regressions compared to #{options['baseline']}:", regressions.map { |message| "  #{message}" }
+    exit 1
+  end
+end
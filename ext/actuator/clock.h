@@ -7,6 +7,10 @@ extern "C"{
 
 void clock_init();
 double clock_time();
+double clock_elapsed();
+void clock_set_virtual(int enabled);
+int clock_is_virtual();
+void clock_advance_to(double time);
 
 #ifdef __cplusplus
 }
@@ -2,4 +2,9 @@ require 'mkmf'
 
 $CXXFLAGS += " -std=c++11 "
 
+# shm_open is in librt before glibc 2.34
+have_library 'rt', 'shm_open'
+# Ruby 3.3 replaced rb_postponed_job_register_one with pre-registered jobs
+have_func 'rb_postponed_job_preregister', 'ruby/debug.h'
+
 create_makefile 'actuator/actuator'
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include <string.h>
+#include <ruby/debug.h>
+#include "reactor.h"
+#include "gc_monitor.h"
+
+struct GcPause
+{
+    double started_at;
+    double ended_at;
+};
+
+Histogram GcMonitor::pauses;
+double GcMonitor::pause_total = 0;
+uint64_t GcMonitor::late_fire_count = 0;
+double GcMonitor::late_total = 0;
+uint64_t GcMonitor::idle_run_count = 0;
+double GcMonitor::idle_headroom = 0;
+double GcMonitor::idle_free_slot_ratio = 0.2;
+
+static GcPause recent_pauses[GcMonitor::RecentPauseCount];
+static int last_pause_index = -1;
+static double pause_started_at = 0;
+static VALUE tracepoint = Qnil;
+static VALUE minor_gc_options = Qnil;
+static VALUE heap_free_slots_sym;
+static VALUE heap_available_slots_sym;
+
+// Internal GC events can't allocate or call into ruby, only the clock may be read here
+static void gc_event_hook(VALUE tpval, void *data)
+{
+    rb_trace_arg_t *trace_arg = rb_tracearg_from_tracepoint(tpval);
+    if (rb_tracearg_event_flag(trace_arg) == RUBY_INTERNAL_EVENT_GC_ENTER) {
+        pause_started_at = clock_time();
+        return;
+    }
+    double ended_at = clock_time();
+    last_pause_index = (last_pause_index + 1) % GcMonitor::RecentPauseCount;
+    recent_pauses[last_pause_index].started_at = pause_started_at;
+    recent_pauses[last_pause_index].ended_at = ended_at;
+    GcMonitor::pauses.Record((int64_t)((ended_at - pause_started_at) * 1000000));
+    GcMonitor::pause_total += ended_at - pause_started_at;
+}
+
+void GcMonitor::Setup()
+{
+    heap_free_slots_sym = ID2SYM(rb_intern("heap_free_slots"));
+    heap_available_slots_sym = ID2SYM(rb_intern("heap_available_slots"));
+
+    minor_gc_options = rb_hash_new();
+    rb_hash_aset(minor_gc_options, ID2SYM(rb_intern("full_mark")), Qfalse);
+    rb_hash_aset(minor_gc_options, ID2SYM(rb_intern("immediate_sweep")), Qfalse);
+    rb_gc_register_address(&minor_gc_options);
+
+    tracepoint = rb_tracepoint_new(0, RUBY_INTERNAL_EVENT_GC_ENTER | RUBY_INTERNAL_EVENT_GC_EXIT, gc_event_hook, 0);
+    rb_gc_register_address(&tracepoint);
+    rb_tracepoint_enable(tracepoint);
+}
+
+// Pauses are recorded with clock_time, which forked children re-baseline
+void GcMonitor::Reset()
+{
+    pauses.Reset();
+    pause_total = 0;
+    late_fire_count = 0;
+    late_total = 0;
+    idle_run_count = 0;
+    memset(recent_pauses, 0, sizeof(recent_pauses));
+    last_pause_index = -1;
+    pause_started_at = 0;
+}
+
+// Returns the number of seconds spent in GC between from and to
+double GcMonitor::Overlap(double from, double to)
+{
+    if (last_pause_index < 0) return 0;
+    double overlap = 0;
+    int index = last_pause_index;
+    for (int i = 0; i < RecentPauseCount; i++) {
+        GcPause &pause = recent_pauses[index];
+        if (pause.ended_at <= from) break;
+        double started_at = pause.started_at > from ? pause.started_at : from;
+        double ended_at = pause.ended_at < to ? pause.ended_at : to;
+        if (ended_at > started_at) overlap += ended_at - started_at;
+        index = (index + RecentPauseCount - 1) % RecentPauseCount;
+    }
+    return overlap;
+}
+
+void GcMonitor::TrackLateFire(double scheduled_at, double fired_at, double late_us)
+{
+    double overlap_us = Overlap(scheduled_at, fired_at) * 1000000;
+    if (overlap_us <= 0) return;
+    late_fire_count++;
+    late_total += (overlap_us < late_us ? overlap_us : late_us) / 1000000;
+}
+
+// Runs a minor GC ahead of time when the heap is close to running out of free slots and the next timer is far enough away
+bool GcMonitor::RunIdle(double now, double next_event_at)
+{
+    if (!idle_headroom) return false;
+    if (next_event_at && next_event_at - now < idle_headroom) return false;
+    size_t free_slots = rb_gc_stat(heap_free_slots_sym);
+    size_t available_slots = rb_gc_stat(heap_available_slots_sym);
+    if (free_slots > available_slots * idle_free_slot_ratio) return false;
+#ifdef RB_PASS_KEYWORDS
+    rb_funcallv_kw(rb_mGC, rb_intern("start"), 1, &minor_gc_options, RB_PASS_KEYWORDS);
+#else
+    rb_funcall(rb_mGC, rb_intern("start"), 1, minor_gc_options);
+#endif
+    idle_run_count++;
+    return true;
+}
+
+VALUE GcMonitor::Stats()
+{
+    VALUE hash = rb_hash_new();
+    rb_hash_aset(hash, ID2SYM(rb_intern("pauses")), ULL2NUM(pauses.count));
+    rb_hash_aset(hash, ID2SYM(rb_intern("pause_us_total")), LL2NUM((long long)(pause_total * 1000000)));
+    rb_hash_aset(hash, ID2SYM(rb_intern("pause_us_p99")), LL2NUM(pauses.Percentile(99)));
+    rb_hash_aset(hash, ID2SYM(rb_intern("pause_us_max")), LL2NUM(pauses.max));
+    rb_hash_aset(hash, ID2SYM(rb_intern("late_fires")), ULL2NUM(late_fire_count));
+    rb_hash_aset(hash, ID2SYM(rb_intern("late_us_total")), LL2NUM((long long)(late_total * 1000000)));
+    rb_hash_aset(hash, ID2SYM(rb_intern("idle_runs")), ULL2NUM(idle_run_count));
+    return hash;
+}
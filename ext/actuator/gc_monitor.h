@@ -0,0 +1,28 @@
+#ifndef ACTUATOR_GC_MONITOR_H
+#define ACTUATOR_GC_MONITOR_H
+
+#include <ruby.h>
+#include "histogram.h"
+
+// Measures GC pauses so that timer lateness caused by GC can be told apart from slow callbacks
+class GcMonitor {
+public:
+    static const int RecentPauseCount = 64;
+
+    static Histogram pauses;
+    static double pause_total;
+    static uint64_t late_fire_count;
+    static double late_total;
+    static uint64_t idle_run_count;
+    static double idle_headroom;
+    static double idle_free_slot_ratio;
+
+    static void Setup();
+    static void Reset();
+    static double Overlap(double from, double to);
+    static bool RunIdle(double now, double next_event_at);
+    static void TrackLateFire(double scheduled_at, double fired_at, double late_us);
+    static VALUE Stats();
+};
+
+#endif
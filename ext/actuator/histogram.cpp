@@ -0,0 +1,60 @@
+#include <string.h>
+#include "histogram.h"
+
+Histogram::Histogram()
+{
+    Reset();
+}
+
+void Histogram::Record(int64_t value)
+{
+    if (value < 0) value = 0;
+    if (value > MaxValue) value = MaxValue;
+    buckets[BucketIndex(value)]++;
+    if (value < min) min = value;
+    if (value > max) max = value;
+    count++;
+}
+
+void Histogram::Reset()
+{
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    min = MaxValue;
+    max = 0;
+}
+
+// Returns the upper bound of the bucket containing the percentile, clamped to the exact maximum
+int64_t Histogram::Percentile(double percentile)
+{
+    if (!count) return 0;
+    uint64_t target = (uint64_t)(count * percentile / 100.0 + 0.5);
+    if (target < 1) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BucketCount; i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            int64_t value = BucketUpperBound(i);
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
+
+// Values below SubBucketCount get their own bucket, each power of two above that is split into SubBucketCount / 2 buckets
+int Histogram::BucketIndex(int64_t value)
+{
+    if (value < SubBucketCount) return (int)value;
+    int msb = SubBucketBits;
+    while (value >> (msb + 1)) msb++;
+    int shift = msb - (SubBucketBits - 1);
+    return shift * (SubBucketCount / 2) + (int)(value >> shift);
+}
+
+int64_t Histogram::BucketUpperBound(int index)
+{
+    if (index < SubBucketCount) return index;
+    int shift = index / (SubBucketCount / 2) - 1;
+    int64_t sub_bucket = index % (SubBucketCount / 2) + SubBucketCount / 2;
+    return ((sub_bucket + 1) << shift) - 1;
+}
@@ -0,0 +1,28 @@
+#ifndef ACTUATOR_HISTOGRAM_H
+#define ACTUATOR_HISTOGRAM_H
+
+#include <stdint.h>
+
+// Log-linear histogram of microsecond values with ~6% precision and constant time recording
+class Histogram {
+public:
+    static const int SubBucketBits = 5;
+    static const int SubBucketCount = 1 << SubBucketBits;
+    static const int BucketCount = 512;
+    static const int64_t MaxValue = 1000000000LL;
+
+    uint32_t buckets[BucketCount];
+    uint64_t count;
+    int64_t min;
+    int64_t max;
+
+    Histogram();
+    void Record(int64_t value);
+    void Reset();
+    int64_t Percentile(double percentile);
+
+    static int BucketIndex(int64_t value);
+    static int64_t BucketUpperBound(int index);
+};
+
+#endif
@@ -1,3 +1,4 @@
+#include <string>
 #include <ruby.h>
 #include "reactor.h"
 
@@ -12,17 +13,26 @@ enum class LogLevel
 
 FILE *Log::debug_file = 0;
 FILE *Log::log_file = 0;
+uint64_t Log::line_count = 0;
+uint64_t Log::dropped_count = 0;
 
 static VALUE LogClass;
 static LogLevel Level = LogLevel::Info;
+// Path of the log file opened with Log.file_path= so that it can be reopened by forked children
+static std::string log_path;
 
 static void Print(const char *tag, const char *format, va_list args)
 {
     if (!Log::log_file) return;
-    fprintf(Log::log_file, "%010.3f %s ", clock_time() * 1000, tag);
-    vfprintf(Log::log_file, format, args);
-    fprintf(Log::log_file, "\n");
-    fflush(Log::log_file);
+    Log::line_count++;
+    bool failed = fprintf(Log::log_file, "%010.3f %s ", clock_elapsed() * 1000, tag) < 0;
+    failed |= vfprintf(Log::log_file, format, args) < 0;
+    failed |= fprintf(Log::log_file, "\n") < 0;
+    failed |= fflush(Log::log_file) != 0;
+    if (failed) {
+        Log::dropped_count++;
+        clearerr(Log::log_file);
+    }
 }
 
 static VALUE Log_Debug(VALUE self, VALUE message)
@@ -53,10 +63,13 @@ static VALUE Log_SetFilePath(VALUE self, VALUE path)
 {
     if (NIL_P(path)) {
         Log::log_file = 0;
+        log_path.clear();
     } else if (SYMBOL_P(path) && SYM2ID(path) == rb_intern("stdout")) {
         Log::log_file = stdout;
+        log_path.clear();
     } else if (RB_TYPE_P(path, T_STRING) && CLASS_OF(path) == rb_cString) {
         Log::log_file = fopen(RSTRING_PTR(path), "w");
+        log_path = Log::log_file ? RSTRING_PTR(path) : "";
     } else {
         rb_raise(rb_eRuntimeError, "path must be a string, :stdout or nil");
     }
@@ -135,4 +148,14 @@ void Log::Error(const char *format, ...)
     va_start(args, format);
     Print("ERROR", format, args);
     va_end(args);
-}
\ No newline at end of file
+}
+
+// Forked children get their own handle in append mode so that they don't share the stdio buffer of the parent or
+// truncate its log. Lines are flushed as they are written so nothing buffered by the parent is written twice.
+void Log::Reopen()
+{
+    if (log_path.empty() || !log_file) return;
+    fclose(log_file);
+    log_file = fopen(log_path.c_str(), "a");
+    if (!log_file) log_path.clear();
+}
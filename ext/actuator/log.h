@@ -1,6 +1,7 @@
 #ifndef ACTUATOR_LOG_H
 #define ACTUATOR_LOG_H
 
+#include <stdint.h>
 #include "actuator.h"
 
 class Log {
@@ -10,9 +11,13 @@ public:
     static void Info(const char *format, ...);
     static void Warn(const char *format, ...);
     static void Error(const char *format, ...);
+    static void Reopen();
 
     static FILE *debug_file;
     static FILE *log_file;
+    static uint64_t line_count;
+    // Lines which could not be written, e.g. when stdout is a closed pipe or the disk is full
+    static uint64_t dropped_count;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include <errno.h>
+#include <string.h>
+#include "reactor.h"
+#include "metrics.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+const double DefaultMetricsInterval = 0.001;
+
+double Metrics::interval = DefaultMetricsInterval;
+
+static MetricsSegment *segment = 0;
+static char segment_name[256];
+static double next_publish_at = 0;
+
+// Fiber pool counters live in ruby, they are read from the pool's instance variables when publishing
+static VALUE fiber_pool = Qnil;
+static ID busy_count_id;
+static ID idle_fibers_id;
+static ID queued_jobs_id;
+static ID created_count_id;
+static ID evicted_count_id;
+
+static uint32_t ivar_array_size(VALUE object, ID id)
+{
+    VALUE value = rb_ivar_get(object, id);
+    return RB_TYPE_P(value, T_ARRAY) ? (uint32_t)RARRAY_LEN(value) : 0;
+}
+
+static uint64_t ivar_count(VALUE object, ID id)
+{
+    VALUE value = rb_ivar_get(object, id);
+    return FIXNUM_P(value) ? (uint64_t)FIX2LONG(value) : 0;
+}
+
+// Actuator.publish_metrics(name="actuator.<pid>", interval=0.001) - returns the path of the segment
+static VALUE Actuator_publish_metrics(int argc, VALUE *argv, VALUE klass)
+{
+    VALUE name, interval;
+    rb_scan_args(argc, argv, "02", &name, &interval);
+    if (!NIL_P(interval)) {
+        double seconds = NUM2DBL(interval);
+        if (seconds < 0) rb_raise(rb_eArgError, "interval must not be negative");
+        Metrics::interval = seconds;
+    }
+    VALUE default_name = rb_sprintf("actuator.%d", (int)getpid());
+    if (NIL_P(name)) name = default_name;
+    if (!Metrics::Open(StringValueCStr(name))) rb_sys_fail(StringValueCStr(name));
+    RB_GC_GUARD(default_name);
+    return rb_sprintf("/dev/shm/%s", segment_name);
+}
+
+static VALUE Actuator_unpublish_metrics(VALUE klass)
+{
+    Metrics::Close();
+    return Qnil;
+}
+
+static VALUE Actuator_metrics_path(VALUE klass)
+{
+    return Metrics::IsOpen() ? rb_sprintf("/dev/shm/%s", segment_name) : Qnil;
+}
+
+static void metrics_end_proc(VALUE _)
+{
+    Metrics::Close();
+}
+
+void Metrics::Setup()
+{
+    busy_count_id = rb_intern("@busy_count");
+    idle_fibers_id = rb_intern("@idle_fibers");
+    queued_jobs_id = rb_intern("@queued_jobs");
+    created_count_id = rb_intern("@created_count");
+    evicted_count_id = rb_intern("@evicted_count");
+    rb_gc_register_address(&fiber_pool);
+    // Segments are removed when the process exits so that readers don't keep sampling stale counters
+    rb_set_end_proc(metrics_end_proc, Qnil);
+
+    VALUE ActuatorClass = rb_define_module("Actuator");
+    rb_define_singleton_method(ActuatorClass, "publish_metrics", RUBY_METHOD_FUNC(Actuator_publish_metrics), -1);
+    rb_define_singleton_method(ActuatorClass, "unpublish_metrics", RUBY_METHOD_FUNC(Actuator_unpublish_metrics), 0);
+    rb_define_singleton_method(ActuatorClass, "metrics_path", RUBY_METHOD_FUNC(Actuator_metrics_path), 0);
+}
+
+bool Metrics::IsOpen()
+{
+    return segment != 0;
+}
+
+#ifdef _WIN32
+
+bool Metrics::Open(const char *name)
+{
+    rb_raise(rb_eNotImpError, "shared memory metrics are only supported on POSIX platforms");
+    return false;
+}
+
+void Metrics::Close()
+{
+}
+
+void Metrics::Publish(double now)
+{
+}
+
+#else
+
+bool Metrics::Open(const char *name)
+{
+    if (strlen(name) >= sizeof(segment_name) || strchr(name, '/')) {
+        errno = EINVAL;
+        return false;
+    }
+    Close();
+    char path[sizeof(segment_name) + 1];
+    snprintf(path, sizeof(path), "/%s", name);
+    int fd = shm_open(path, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, sizeof(MetricsSegment)) != 0) {
+        int error = errno;
+        close(fd);
+        shm_unlink(path);
+        errno = error;
+        return false;
+    }
+    void *memory = mmap(0, sizeof(MetricsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        int error = errno;
+        shm_unlink(path);
+        errno = error;
+        return false;
+    }
+    strcpy(segment_name, name);
+    segment = (MetricsSegment*)memory;
+    memset(segment, 0, sizeof(MetricsSegment));
+    segment->version = MetricsVersion;
+    segment->size = sizeof(MetricsSegment);
+    segment->pid = getpid();
+    segment->lateness_bucket_count = Histogram::BucketCount;
+    segment->lateness_sub_bucket_bits = Histogram::SubBucketBits;
+    // Readers check the magic last so that they never see a segment which has not been initialized
+    __atomic_store_n(&segment->magic, MetricsMagic, __ATOMIC_RELEASE);
+
+    VALUE ActuatorClass = rb_define_module("Actuator");
+    if (rb_const_defined(ActuatorClass, rb_intern("FiberPool"))) fiber_pool = rb_const_get(ActuatorClass, rb_intern("FiberPool"));
+    next_publish_at = 0;
+    Publish(clock_time());
+    return true;
+}
+
+void Metrics::Close()
+{
+    if (!segment) return;
+    // Forked children inherit the mapping but the segment belongs to the process which created it
+    bool is_owner = segment->pid == (uint32_t)getpid();
+    munmap(segment, sizeof(MetricsSegment));
+    segment = 0;
+    if (!is_owner) return;
+    char path[sizeof(segment_name) + 1];
+    snprintf(path, sizeof(path), "/%s", segment_name);
+    shm_unlink(path);
+}
+
+void Metrics::Publish(double now)
+{
+    if (!segment || now < next_publish_at) return;
+    next_publish_at = now + interval;
+
+    uint64_t sequence = segment->sequence;
+    __atomic_store_n(&segment->sequence, sequence + 1, __ATOMIC_RELAXED);
+    // Keeps the odd sequence from being reordered after any of the field stores below
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    segment->publish_count++;
+    // Real elapsed time so that it doesn't jump ahead after virtual clock runs, unlike the reactor time in now
+    segment->published_at = clock_elapsed();
+    timeval wall_time;
+    gettimeofday(&wall_time, 0);
+    segment->wall_time_us = (uint64_t)wall_time.tv_sec * 1000000 + wall_time.tv_usec;
+    Timer::Publish(segment);
+    if (!NIL_P(fiber_pool)) {
+        segment->fibers_busy = (uint32_t)ivar_count(fiber_pool, busy_count_id);
+        segment->fibers_idle = ivar_array_size(fiber_pool, idle_fibers_id);
+        segment->jobs_queued = ivar_array_size(fiber_pool, queued_jobs_id);
+        segment->fibers_created = ivar_count(fiber_pool, created_count_id);
+        segment->fibers_evicted = ivar_count(fiber_pool, evicted_count_id);
+    }
+    segment->log_lines = Log::line_count;
+    segment->log_dropped = Log::dropped_count;
+
+    __atomic_store_n(&segment->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+#endif
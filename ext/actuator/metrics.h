@@ -0,0 +1,60 @@
+#ifndef ACTUATOR_METRICS_H
+#define ACTUATOR_METRICS_H
+
+#include <stdint.h>
+#include <ruby.h>
+#include "histogram.h"
+
+const uint32_t MetricsMagic = 0x4D544341; // "ACTM"
+const uint32_t MetricsVersion = 1;
+
+// Layout of the shared memory segment, lib/actuator/metrics_reader.rb must be kept in sync when fields change.
+// The sequence is odd while the reactor is writing, readers copy the segment and retry until the sequence they read
+// before and after the copy is the same even number.
+struct MetricsSegment {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t pid;
+    uint64_t sequence;
+    uint64_t publish_count;
+    double published_at;
+    uint64_t wall_time_us;
+    uint64_t frames;
+    uint64_t empty_frames;
+    uint64_t fires;
+    uint64_t deferred;
+    uint32_t active_timers;
+    uint32_t scheduled_timers;
+    uint32_t timer_objects;
+    uint32_t gc_registered;
+    uint32_t fibers_busy;
+    uint32_t fibers_idle;
+    uint32_t jobs_queued;
+    uint32_t padding;
+    uint64_t fibers_created;
+    uint64_t fibers_evicted;
+    uint64_t log_lines;
+    uint64_t log_dropped;
+    uint64_t lateness_count;
+    int64_t lateness_min;
+    int64_t lateness_max;
+    uint32_t lateness_bucket_count;
+    uint32_t lateness_sub_bucket_bits;
+    uint32_t lateness_buckets[Histogram::BucketCount];
+};
+
+// Publishes reactor counters to a POSIX shared memory segment so that monitoring agents can sample them without
+// calling into the process. The reactor writes a snapshot at most once per interval, readers never block it.
+class Metrics {
+public:
+    static double interval;
+
+    static void Setup();
+    static bool Open(const char *name);
+    static void Close();
+    static void Publish(double now);
+    static bool IsOpen();
+};
+
+#endif
@@ -1,25 +1,71 @@
 #include "reactor.h"
+#include "realtime.h"
+#include "gc_monitor.h"
+#include "metrics.h"
+#include "watchdog.h"
+#include "timer_pool.h"
+#include "timer_group.h"
 
 Actuator *actuator = 0;
 
 Actuator::Actuator()
 {
+    posted_queue = rb_ary_new();
+    rb_gc_register_address(&posted_queue);
+    idle_queue = rb_ary_new();
+    rb_gc_register_address(&idle_queue);
 }
 
 Actuator::~Actuator()
 {
 }
 
-void Actuator::Start()
+static VALUE actuator_run(VALUE data)
+{
+    ((Actuator*)data)->Run();
+    return Qnil;
+}
+
+static VALUE actuator_finish(VALUE data)
+{
+    ((Actuator*)data)->Finish();
+    return Qnil;
+}
+
+void Actuator::Start(VALUE options)
 {
     if (is_running) {
         Log::Warn("[Actuator] Start called while already running");
         return;
     }
 
+    // Options are applied before the reactor counts as running since any of them can raise
+    double stall_threshold = 0;
+    if (!NIL_P(options)) {
+        Check_Type(options, T_HASH);
+        VALUE threshold = rb_hash_aref(options, ID2SYM(rb_intern("stall_threshold")));
+        if (!NIL_P(threshold)) {
+            stall_threshold = NUM2DBL(threshold);
+            if (stall_threshold <= 0) rb_raise(rb_eArgError, "stall threshold must be greater than 0");
+            if (!Watchdog::IsSupported()) rb_raise(rb_eNotImpError, "the stall watchdog requires ruby 3.3 or later");
+        }
+    }
+    Realtime::Apply(options);
+    // The virtual_clock option only lasts for this run, Actuator.virtual_clock= is kept across runs
+    restores_real_clock = !NIL_P(options) && RTEST(rb_hash_aref(options, ID2SYM(rb_intern("virtual_clock")))) && !clock_is_virtual();
+    if (restores_real_clock) clock_set_virtual(1);
+    if (stall_threshold) Watchdog::Start(stall_threshold);
+
     thread = rb_thread_current();
     is_running = true;
+    Watchdog::is_idle = false;
 
+    // Exceptions raised by callbacks propagate out of the loop, the reactor is still torn down so it can be restarted
+    rb_ensure(RUBY_METHOD_FUNC(actuator_run), (VALUE)this, RUBY_METHOD_FUNC(actuator_finish), (VALUE)this);
+}
+
+void Actuator::Run()
+{
     if (rb_block_given_p()) rb_yield(Qundef);
 
     long total_ticks = 0;
@@ -30,6 +76,8 @@ void Actuator::Start()
     {
         total_ticks++;
 
+        Watchdog::Tick();
+
         Timer::Update(now);
 
         int remaining_dequeues = next_tick_queue.size();
@@ -42,11 +90,35 @@ void Actuator::Start()
 
         if (!is_running) break;
 
+        RunPosted();
+
+        if (!is_running) break;
+
         now = clock_time();
 
+        if (RunIdle(now)) {
+            if (!is_running) break;
+            now = clock_time();
+        }
+
         timeval delay_duration;
         double next_timer_at = Timer::GetNextEventTime();
-        if (next_timer_at) {
+        if (GcMonitor::RunIdle(now, next_timer_at)) now = clock_time();
+        Metrics::Publish(now);
+        if (clock_is_virtual()) {
+            // Jump straight to the next timer instead of sleeping, the reactor only sleeps in real time without
+            // moving the clock when nothing is scheduled so that other threads get a chance to queue work
+            if (next_timer_at) {
+                clock_advance_to(next_timer_at);
+                now = clock_time();
+                continue;
+            }
+            if (RARRAY_LEN(idle_queue)) continue;
+        }
+        if (RARRAY_LEN(posted_queue)) {
+            // Blocks posted after this tick drained the queue are run without waiting for the next timer
+            delay_duration.tv_sec = delay_duration.tv_usec = 0;
+        } else if (next_timer_at) {
             double delay = next_timer_at - now;
             if (delay > 0) {
                 if (delay > max_delta) {
@@ -69,10 +141,14 @@ void Actuator::Start()
         }
 
         is_sleeping = true;
+        // Sleeping is not a stall, the watchdog only watches the heartbeat while the reactor is busy
+        Watchdog::is_idle = true;
 
         // rb_thread_wait_for has far better precision on Windows builds than using undocumented kernel system calls
         rb_thread_wait_for(delay_duration);
 
+        Watchdog::Beat();
+        Watchdog::is_idle = false;
         is_waking = false;
         is_sleeping = false;
 
@@ -92,10 +168,65 @@ void Actuator::Start()
 
         now = clock_time();
     }
+}
 
+void Actuator::Finish()
+{
+    is_running = false;
+    is_sleeping = false;
+    is_waking = false;
+    Watchdog::is_idle = true;
+    Teardown();
+    if (restores_real_clock) {
+        clock_set_virtual(0);
+        restores_real_clock = false;
+    }
     thread = 0;
 }
 
+// Called in forked children, which would otherwise fire the timers of their parent, write to its log handle and
+// metrics segment and count time from the parent's clock baseline. A reactor which was running when the process
+// forked stops in the child once the forking callback or job returns to the loop, which then tears it down. Tearing
+// down here would release timers which are still firing further up the stack.
+void Actuator::AfterFork()
+{
+    if (is_running) {
+        is_running = false;
+    } else {
+        Teardown();
+    }
+    is_sleeping = false;
+    is_waking = false;
+    clock_init();
+    Timer::ResetStats();
+    GcMonitor::Reset();
+    Log::Reopen();
+    Metrics::Close();
+    Watchdog::AfterFork();
+    Realtime::AfterFork();
+    posted_count = 0;
+    idle_run_count = 0;
+    idle_total = 0;
+}
+
+// Releases everything the reactor holds once its loop has ended so that it can be started again without leaking
+// timers, GC roots or queued work from the previous run
+void Actuator::Teardown()
+{
+    Timer::Clear();
+    TimerGroup::Clear();
+    TimerPool::Clear();
+    std::queue<VALUE>().swap(next_tick_queue);
+    // Blocks posted by offload workers after the reactor stopped would resume jobs from the previous run
+    rb_ary_clear(posted_queue);
+    rb_ary_clear(idle_queue);
+    idle_deadline = 0;
+    // Idle fibers are only resumed by the reactor, they would keep their stacks until the next run trims them
+    VALUE ActuatorClass = rb_define_module("Actuator");
+    if (rb_const_defined(ActuatorClass, rb_intern("FiberPool")))
+        rb_funcall(rb_const_get(ActuatorClass, rb_intern("FiberPool")), rb_intern("evict_idle"), 0);
+}
+
 void Actuator::Stop()
 {
     if (!is_running) {
@@ -103,10 +234,58 @@ void Actuator::Stop()
         return;
     }
     is_running = false;
-    Timer::Clear();
     if (is_sleeping) Wake();
 }
 
+// Called from any ruby thread, the block runs on the reactor thread during the next tick
+void Actuator::Post(VALUE block)
+{
+    rb_ary_push(posted_queue, block);
+    Wake();
+}
+
+void Actuator::RunPosted()
+{
+    long remaining = RARRAY_LEN(posted_queue);
+    while (remaining-- > 0 && is_running) {
+        posted_count++;
+        rb_proc_call_fast(rb_ary_shift(posted_queue));
+    }
+}
+
+void Actuator::Idle(VALUE block)
+{
+    rb_ary_push(idle_queue, block);
+}
+
+// Runs queued idle tasks while the next timer is further away than idle_margin, each task gets at most idle_slice
+bool Actuator::RunIdle(double now)
+{
+    if (!RARRAY_LEN(idle_queue)) return false;
+    double started_at = now;
+    // The virtual clock doesn't move while idle tasks run, so each task queued before this tick runs once without a slice
+    bool is_virtual = clock_is_virtual();
+    long remaining = RARRAY_LEN(idle_queue);
+    while (RARRAY_LEN(idle_queue) && is_running) {
+        if (is_virtual && remaining-- <= 0) break;
+        double next_timer_at = Timer::GetNextEventTime();
+        double deadline = is_virtual ? now : now + idle_slice;
+        if (next_timer_at) {
+            if (next_timer_at - now <= idle_margin) break;
+            if (next_timer_at - idle_margin < deadline) deadline = next_timer_at - idle_margin;
+        }
+        // Return to the reactor loop regularly so that next tick callbacks and wake ups are processed
+        if (now - started_at >= max_delta) break;
+        idle_deadline = deadline;
+        idle_run_count++;
+        rb_proc_call_fast(rb_ary_shift(idle_queue));
+        idle_deadline = 0;
+        now = clock_time();
+    }
+    idle_total += now - started_at;
+    return now > started_at;
+}
+
 void Actuator::Wake()
 {
     if (!is_sleeping || is_waking) return;
@@ -119,17 +298,32 @@ static VALUE Actuator_now(VALUE klass)
     return DBL2NUM(clock_time());
 }
 
+static VALUE Actuator_is_virtual_clock(VALUE klass)
+{
+    return clock_is_virtual() ? Qtrue : Qfalse;
+}
+
+// Actuator.now stays continuous when switching, timers keep their deadlines and fire in the same order
+static VALUE Actuator_virtual_clock_set(VALUE klass, VALUE enabled)
+{
+    clock_set_virtual(RTEST(enabled));
+    return enabled;
+}
+
 static VALUE Actuator_is_running(VALUE klass)
 {
     return actuator->is_running ? Qtrue : Qfalse;
 }
 
-static VALUE Actuator_start(VALUE klass)
+static VALUE Actuator_start(int argc, VALUE *argv, VALUE klass)
 {
+    VALUE options;
+    rb_scan_args(argc, argv, "01", &options);
     if (actuator->is_running) {
+        if (!NIL_P(options)) Log::Warn("[Actuator] Start options ignored since the reactor is already running");
         if (rb_block_given_p()) rb_yield(Qundef);
     } else {
-        actuator->Start();
+        actuator->Start(options);
     }
     return Qnil;
 }
@@ -146,6 +340,124 @@ static VALUE Actuator_wake(VALUE klass)
     return Qnil;
 }
 
+static VALUE Actuator_stats(VALUE klass)
+{
+    VALUE hash = rb_hash_new();
+    rb_hash_aset(hash, ID2SYM(rb_intern("timers")), Timer::Stats());
+    VALUE idle = rb_hash_new();
+    rb_hash_aset(idle, ID2SYM(rb_intern("queued")), LONG2NUM(RARRAY_LEN(actuator->idle_queue)));
+    rb_hash_aset(idle, ID2SYM(rb_intern("runs")), ULL2NUM(actuator->idle_run_count));
+    rb_hash_aset(idle, ID2SYM(rb_intern("time_us_total")), LL2NUM((long long)(actuator->idle_total * 1000000)));
+    rb_hash_aset(hash, ID2SYM(rb_intern("idle")), idle);
+    VALUE posted = rb_hash_new();
+    rb_hash_aset(posted, ID2SYM(rb_intern("queued")), LONG2NUM(RARRAY_LEN(actuator->posted_queue)));
+    rb_hash_aset(posted, ID2SYM(rb_intern("runs")), ULL2NUM(actuator->posted_count));
+    rb_hash_aset(hash, ID2SYM(rb_intern("posted")), posted);
+    rb_hash_aset(hash, ID2SYM(rb_intern("realtime")), Realtime::Stats());
+    rb_hash_aset(hash, ID2SYM(rb_intern("gc")), GcMonitor::Stats());
+    rb_hash_aset(hash, ID2SYM(rb_intern("watchdog")), Watchdog::Stats());
+    return hash;
+}
+
+static void add_memory_stat(VALUE hash, const char *name, size_t bytes, size_t &total)
+{
+    rb_hash_aset(hash, ID2SYM(rb_intern(name)), SIZET2NUM(bytes));
+    total += bytes;
+}
+
+// Native bytes held by the reactor, ruby objects such as timer callbacks are accounted for by ObjectSpace
+static VALUE Actuator_memory_stats(VALUE klass)
+{
+    VALUE hash = rb_hash_new();
+    size_t total = 0;
+    add_memory_stat(hash, "timers", Timer::MemoryUsage(), total);
+    add_memory_stat(hash, "timer_pool", TimerPool::MemoryUsage(), total);
+    add_memory_stat(hash, "timer_groups", TimerGroup::MemoryUsage(), total);
+    size_t queued_count = actuator->next_tick_queue.size() + RARRAY_LEN(actuator->posted_queue) + RARRAY_LEN(actuator->idle_queue);
+    add_memory_stat(hash, "queues", queued_count * sizeof(VALUE), total);
+    add_memory_stat(hash, "histograms", sizeof(Timer::lateness) + sizeof(GcMonitor::pauses), total);
+    // Log files are written through stdio which buffers each open file
+    add_memory_stat(hash, "log", ((Log::log_file ? 1 : 0) + (Log::debug_file ? 1 : 0)) * BUFSIZ, total);
+    add_memory_stat(hash, "metrics", Metrics::IsOpen() ? sizeof(MetricsSegment) : 0, total);
+    rb_hash_aset(hash, ID2SYM(rb_intern("total")), SIZET2NUM(total));
+    return hash;
+}
+
+static VALUE Actuator_after_fork(VALUE klass)
+{
+    actuator->AfterFork();
+    return Qnil;
+}
+
+// Pins the calling thread to the given CPU or CPUs, see Actuator.fork_workers
+static VALUE Actuator_cpu_affinity_set(VALUE klass, VALUE cpus)
+{
+    Realtime::ApplyAffinity(cpus);
+    return cpus;
+}
+
+// Array of CPU ids the process is allowed to run on, nil when the platform can't tell
+static VALUE Actuator_allowed_cpus(VALUE klass)
+{
+    return Realtime::AllowedCpus();
+}
+
+static VALUE Actuator_idle_gc_headroom(VALUE klass)
+{
+    return GcMonitor::idle_headroom ? DBL2NUM(GcMonitor::idle_headroom) : Qnil;
+}
+
+// Minor GCs run while the reactor is idle when the next timer is at least this many seconds away, nil disables
+static VALUE Actuator_idle_gc_headroom_set(VALUE klass, VALUE headroom)
+{
+    GcMonitor::idle_headroom = NIL_P(headroom) ? 0 : NUM2DBL(headroom);
+    return headroom;
+}
+
+static VALUE Actuator_post(VALUE klass)
+{
+    rb_need_block();
+    actuator->Post(rb_block_proc());
+    return Qnil;
+}
+
+static VALUE Actuator_idle(VALUE klass)
+{
+    rb_need_block();
+    actuator->Idle(rb_block_proc());
+    return Qnil;
+}
+
+// Seconds left in the slice of the idle task which is currently running, 0 outside of idle tasks
+static VALUE Actuator_idle_time_left(VALUE klass)
+{
+    if (!actuator->idle_deadline) return DBL2NUM(0);
+    double time_left = actuator->idle_deadline - clock_time();
+    return DBL2NUM(time_left > 0 ? time_left : 0);
+}
+
+static VALUE Actuator_idle_margin(VALUE klass)
+{
+    return DBL2NUM(actuator->idle_margin);
+}
+
+static VALUE Actuator_idle_margin_set(VALUE klass, VALUE margin)
+{
+    actuator->idle_margin = NUM2DBL(margin);
+    return margin;
+}
+
+static VALUE Actuator_idle_slice(VALUE klass)
+{
+    return DBL2NUM(actuator->idle_slice);
+}
+
+static VALUE Actuator_idle_slice_set(VALUE klass, VALUE slice)
+{
+    actuator->idle_slice = NUM2DBL(slice);
+    return slice;
+}
+
 static VALUE Actuator_next_tick(VALUE self)
 {
     //TODO: Prevent proc from being GC'd while scheduled
@@ -199,13 +511,32 @@ void Init_actuator()
 
     Log::Setup();
     Timer::Setup();
+    GcMonitor::Setup();
+    Metrics::Setup();
+    Watchdog::Setup();
 
     VALUE ActuatorClass = rb_define_module("Actuator");
     rb_define_singleton_method(ActuatorClass, "now", RUBY_METHOD_FUNC(Actuator_now), 0);
+    rb_define_singleton_method(ActuatorClass, "virtual_clock?", RUBY_METHOD_FUNC(Actuator_is_virtual_clock), 0);
+    rb_define_singleton_method(ActuatorClass, "virtual_clock=", RUBY_METHOD_FUNC(Actuator_virtual_clock_set), 1);
     rb_define_singleton_method(ActuatorClass, "running?", RUBY_METHOD_FUNC(Actuator_is_running), 0);
-    rb_define_singleton_method(ActuatorClass, "start", RUBY_METHOD_FUNC(Actuator_start), 0);
+    rb_define_singleton_method(ActuatorClass, "start", RUBY_METHOD_FUNC(Actuator_start), -1);
     rb_define_singleton_method(ActuatorClass, "stop", RUBY_METHOD_FUNC(Actuator_stop), 0);
     rb_define_singleton_method(ActuatorClass, "wake", RUBY_METHOD_FUNC(Actuator_wake), 0);
+    rb_define_singleton_method(ActuatorClass, "stats", RUBY_METHOD_FUNC(Actuator_stats), 0);
+    rb_define_singleton_method(ActuatorClass, "memory_stats", RUBY_METHOD_FUNC(Actuator_memory_stats), 0);
+    rb_define_singleton_method(ActuatorClass, "_after_fork", RUBY_METHOD_FUNC(Actuator_after_fork), 0);
+    rb_define_singleton_method(ActuatorClass, "cpu_affinity=", RUBY_METHOD_FUNC(Actuator_cpu_affinity_set), 1);
+    rb_define_singleton_method(ActuatorClass, "allowed_cpus", RUBY_METHOD_FUNC(Actuator_allowed_cpus), 0);
+    rb_define_singleton_method(ActuatorClass, "post", RUBY_METHOD_FUNC(Actuator_post), 0);
+    rb_define_singleton_method(ActuatorClass, "idle", RUBY_METHOD_FUNC(Actuator_idle), 0);
+    rb_define_singleton_method(ActuatorClass, "idle_time_left", RUBY_METHOD_FUNC(Actuator_idle_time_left), 0);
+    rb_define_singleton_method(ActuatorClass, "idle_margin", RUBY_METHOD_FUNC(Actuator_idle_margin), 0);
+    rb_define_singleton_method(ActuatorClass, "idle_margin=", RUBY_METHOD_FUNC(Actuator_idle_margin_set), 1);
+    rb_define_singleton_method(ActuatorClass, "idle_slice", RUBY_METHOD_FUNC(Actuator_idle_slice), 0);
+    rb_define_singleton_method(ActuatorClass, "idle_slice=", RUBY_METHOD_FUNC(Actuator_idle_slice_set), 1);
+    rb_define_singleton_method(ActuatorClass, "idle_gc_headroom", RUBY_METHOD_FUNC(Actuator_idle_gc_headroom), 0);
+    rb_define_singleton_method(ActuatorClass, "idle_gc_headroom=", RUBY_METHOD_FUNC(Actuator_idle_gc_headroom_set), 1);
     //rb_define_singleton_method(ActuatorClass, "next_tick", RUBY_METHOD_FUNC(Actuator_next_tick), 0);
     //rb_define_singleton_method(ActuatorClass, "defer", RUBY_METHOD_FUNC(Actuator_defer), 0);
     //rb_define_singleton_method(FiberClass, "sleep", RUBY_METHOD_FUNC(Actuator_sleep), 1);
@@ -14,6 +14,8 @@ public:
     bool is_sleeping = false;
     bool is_waking = false;
     VALUE thread = 0;
+    // Set when the virtual clock was enabled by the virtual_clock start option
+    bool restores_real_clock = false;
 
     const double max_delta = 0.05;
 
@@ -22,12 +24,32 @@ public:
 
     std::queue<VALUE> next_tick_queue;
 
+    // Blocks posted from other ruby threads, pushing and draining is safe since both sides hold the GVL
+    VALUE posted_queue = 0;
+    uint64_t posted_count = 0;
+
+    // Ruby array so that queued idle procs are marked by the GC
+    VALUE idle_queue = 0;
+    double idle_margin = 0.001;
+    double idle_slice = 0.001;
+    double idle_deadline = 0;
+    uint64_t idle_run_count = 0;
+    double idle_total = 0;
+
     Actuator();
     ~Actuator();
 
-    void Start();
+    void Start(VALUE options = Qnil);
+    void Run();
+    void Finish();
     void Stop();
+    void Teardown();
+    void AfterFork();
     void Wake();
+    void Post(VALUE block);
+    void RunPosted();
+    void Idle(VALUE block);
+    bool RunIdle(double now);
     timeval GetNextEventDelay(double now);
 };
 
@@ -0,0 +1,221 @@
+#include <errno.h>
+#include <string.h>
+#include "reactor.h"
+#include "realtime.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#else
+#include <alloca.h>
+#endif
+
+const size_t DefaultPrefaultStackSize = 512 * 1024;
+const int DefaultRealtimePriority = 50;
+// Left untouched below the prefaulted region for the frames and signal handlers which run after prefaulting
+const size_t PrefaultStackHeadroom = 64 * 1024;
+
+RealtimeResult Realtime::affinity = RealtimeResult::NotRequested;
+RealtimeResult Realtime::scheduler = RealtimeResult::NotRequested;
+RealtimeResult Realtime::memory_lock = RealtimeResult::NotRequested;
+RealtimeResult Realtime::stack_prefault = RealtimeResult::NotRequested;
+
+static VALUE option(VALUE options, const char *name)
+{
+    return rb_hash_aref(options, ID2SYM(rb_intern(name)));
+}
+
+static const char* result_name(RealtimeResult result)
+{
+    switch (result) {
+    case RealtimeResult::Applied: return "applied";
+    case RealtimeResult::NotPermitted: return "not_permitted";
+    case RealtimeResult::Unsupported: return "unsupported";
+    case RealtimeResult::Failed: return "failed";
+    default: return "not_requested";
+    }
+}
+
+static RealtimeResult errno_result(int error)
+{
+    return error == EPERM || error == EACCES ? RealtimeResult::NotPermitted : RealtimeResult::Failed;
+}
+
+static void warn_unless_applied(const char *name, RealtimeResult result)
+{
+    if (result == RealtimeResult::Applied || result == RealtimeResult::NotRequested) return;
+    Log::Warn("[Actuator] Unable to apply %s to the reactor thread: %s", name, result_name(result));
+}
+
+void Realtime::Apply(VALUE options)
+{
+    if (NIL_P(options)) return;
+    Check_Type(options, T_HASH);
+
+    VALUE cpus = option(options, "cpus");
+    if (!NIL_P(cpus)) affinity = SetAffinity(cpus);
+
+    VALUE policy = option(options, "scheduler");
+    if (!NIL_P(policy)) scheduler = SetScheduler(policy, option(options, "priority"));
+
+    if (RTEST(option(options, "mlock"))) memory_lock = LockMemory();
+
+    VALUE prefault = option(options, "prefault_stack");
+    if (prefault == Qtrue) stack_prefault = PrefaultStack(DefaultPrefaultStackSize);
+    else if (RTEST(prefault)) stack_prefault = PrefaultStack(NUM2SIZET(prefault));
+
+    warn_unless_applied("CPU affinity", affinity);
+    warn_unless_applied("real-time scheduling", scheduler);
+    warn_unless_applied("memory locking", memory_lock);
+    warn_unless_applied("stack prefaulting", stack_prefault);
+}
+
+// Pins the calling thread, forked workers call this before starting their reactor so that threads they start inherit it
+RealtimeResult Realtime::ApplyAffinity(VALUE cpus)
+{
+    affinity = SetAffinity(cpus);
+    warn_unless_applied("CPU affinity", affinity);
+    return affinity;
+}
+
+// Children don't inherit memory locks, the real-time class is dropped by SCHED_RESET_ON_FORK and the prefaulted stack
+// is shared copy-on-write until written. CPU affinity is inherited so it is still reported.
+void Realtime::AfterFork()
+{
+    scheduler = RealtimeResult::NotRequested;
+    memory_lock = RealtimeResult::NotRequested;
+    stack_prefault = RealtimeResult::NotRequested;
+}
+
+// CPUs the process may run on, taskset, cpusets and containers can restrict it to ids outside of 0...nprocessors
+VALUE Realtime::AllowedCpus()
+{
+    VALUE cpus = rb_ary_new();
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set)) return Qnil;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) if (CPU_ISSET(cpu, &set)) rb_ary_push(cpus, INT2NUM(cpu));
+#elif defined(_WIN32)
+    DWORD_PTR process_mask, system_mask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) return Qnil;
+    for (int cpu = 0; cpu < (int)(sizeof(DWORD_PTR) * 8); cpu++) if (process_mask & ((DWORD_PTR)1 << cpu)) rb_ary_push(cpus, INT2NUM(cpu));
+#else
+    return Qnil;
+#endif
+    return cpus;
+}
+
+VALUE Realtime::Stats()
+{
+    VALUE hash = rb_hash_new();
+    rb_hash_aset(hash, ID2SYM(rb_intern("affinity")), ID2SYM(rb_intern(result_name(affinity))));
+    rb_hash_aset(hash, ID2SYM(rb_intern("scheduler")), ID2SYM(rb_intern(result_name(scheduler))));
+    rb_hash_aset(hash, ID2SYM(rb_intern("mlock")), ID2SYM(rb_intern(result_name(memory_lock))));
+    rb_hash_aset(hash, ID2SYM(rb_intern("prefault_stack")), ID2SYM(rb_intern(result_name(stack_prefault))));
+    return hash;
+}
+
+RealtimeResult Realtime::SetAffinity(VALUE cpus)
+{
+    cpus = rb_Array(cpus);
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (long i = 0; i < RARRAY_LEN(cpus); i++) CPU_SET(NUM2INT(rb_ary_entry(cpus, i)), &set);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    return error ? errno_result(error) : RealtimeResult::Applied;
+#elif defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (long i = 0; i < RARRAY_LEN(cpus); i++) mask |= (DWORD_PTR)1 << NUM2INT(rb_ary_entry(cpus, i));
+    return SetThreadAffinityMask(GetCurrentThread(), mask) ? RealtimeResult::Applied : RealtimeResult::Failed;
+#else
+    return RealtimeResult::Unsupported;
+#endif
+}
+
+RealtimeResult Realtime::SetScheduler(VALUE policy, VALUE priority)
+{
+    if (!SYMBOL_P(policy) || (SYM2ID(policy) != rb_intern("fifo") && SYM2ID(policy) != rb_intern("rr"))) {
+        rb_raise(rb_eArgError, "scheduler must be :fifo or :rr");
+    }
+#ifdef _WIN32
+    // Windows has no real-time scheduling classes for threads, time critical is the closest equivalent
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) ? RealtimeResult::Applied : RealtimeResult::Failed;
+#else
+    int sched_policy = SYM2ID(policy) == rb_intern("fifo") ? SCHED_FIFO : SCHED_RR;
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = NIL_P(priority) ? DefaultRealtimePriority : NUM2INT(priority);
+    int max_priority = sched_get_priority_max(sched_policy);
+    int min_priority = sched_get_priority_min(sched_policy);
+    if (param.sched_priority > max_priority) param.sched_priority = max_priority;
+    if (param.sched_priority < min_priority) param.sched_priority = min_priority;
+#ifdef SCHED_RESET_ON_FORK
+    // Child processes must never inherit the real-time class since they could starve the reactor
+    sched_policy |= SCHED_RESET_ON_FORK;
+#endif
+    // The thread keeps its current scheduling class when the real-time class is not permitted
+    int error = pthread_setschedparam(pthread_self(), sched_policy, &param);
+    return error ? errno_result(error) : RealtimeResult::Applied;
+#endif
+}
+
+RealtimeResult Realtime::LockMemory()
+{
+#ifdef _WIN32
+    return RealtimeResult::Unsupported;
+#else
+    return mlockall(MCL_CURRENT | MCL_FUTURE) ? errno_result(errno) : RealtimeResult::Applied;
+#endif
+}
+
+// Bytes of stack left below the current frame, 0 when the stack size can't be determined
+static size_t stack_space_left()
+{
+    char marker;
+    uintptr_t current = (uintptr_t)&marker;
+#if defined(__linux__)
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr)) return 0;
+    void *stack_address;
+    size_t stack_size;
+    int error = pthread_attr_getstack(&attr, &stack_address, &stack_size);
+    pthread_attr_destroy(&attr);
+    if (error || current < (uintptr_t)stack_address) return 0;
+    return current - (uintptr_t)stack_address;
+#elif defined(_WIN32)
+    ULONG_PTR low, high;
+    GetCurrentThreadStackLimits(&low, &high);
+    return current > low ? current - low : 0;
+#else
+    // Without a way to find the bottom of the stack the whole limit is assumed to be available to the current thread
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_STACK, &limit) || limit.rlim_cur == RLIM_INFINITY) return 0;
+    return (size_t)limit.rlim_cur;
+#endif
+}
+
+// Touches the stack below the current frame so that page faults don't happen while timers are firing. The size is
+// clamped to the stack which is left so that a large prefault_stack option can't overflow it.
+RealtimeResult Realtime::PrefaultStack(size_t size)
+{
+    size_t space_left = stack_space_left();
+    if (!space_left) return RealtimeResult::Unsupported;
+    size_t max_size = space_left > PrefaultStackHeadroom ? space_left - PrefaultStackHeadroom : 0;
+    if (size > max_size) {
+        Log::Warn("[Actuator] Prefaulting %zu bytes of stack instead of %zu, which would overflow the reactor thread's stack", max_size, size);
+        size = max_size;
+    }
+    volatile char *stack = (volatile char*)alloca(size);
+    for (size_t i = 0; i < size; i += 4096) stack[i] = 0;
+    return RealtimeResult::Applied;
+}
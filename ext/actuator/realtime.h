@@ -0,0 +1,35 @@
+#ifndef ACTUATOR_REALTIME_H
+#define ACTUATOR_REALTIME_H
+
+#include <ruby.h>
+
+enum class RealtimeResult
+{
+    NotRequested,
+    Applied,
+    NotPermitted,
+    Unsupported,
+    Failed
+};
+
+// Optional real-time tuning which is applied to the reactor thread by Actuator.start
+class Realtime {
+public:
+    static RealtimeResult affinity;
+    static RealtimeResult scheduler;
+    static RealtimeResult memory_lock;
+    static RealtimeResult stack_prefault;
+
+    static void Apply(VALUE options);
+    static RealtimeResult ApplyAffinity(VALUE cpus);
+    static VALUE AllowedCpus();
+    static void AfterFork();
+    static VALUE Stats();
+private:
+    static RealtimeResult SetAffinity(VALUE cpus);
+    static RealtimeResult SetScheduler(VALUE policy, VALUE priority);
+    static RealtimeResult LockMemory();
+    static RealtimeResult PrefaultStack(size_t size);
+};
+
+#endif
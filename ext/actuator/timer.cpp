@@ -1,4 +1,8 @@
 #include "reactor.h"
+#include "gc_monitor.h"
+#include "timer_pool.h"
+#include "timer_group.h"
+#include "metrics.h"
 
 const unsigned int MaxOutstandingTimers = 1000000;
 
@@ -19,11 +23,22 @@ static int last_second_earliest_fire = INT_MAX;
 static int current_second_latest_fire = 0;
 static int last_second_latest_fire = 0;
 static int current_second_started_at = 0;
+static double tick_budget = 0;
+static uint64_t budget_exceeded_count = 0;
+static uint64_t deferred_count = 0;
+// Totals since the process started, the per second counters above are only kept for Timer.stats
+static uint64_t total_frame_count = 0;
+static uint64_t total_empty_frame_count = 0;
+static uint64_t total_fire_count = 0;
 
 //TODO: Consider replacing multimap with a high precision timer wheel implementation like the one I built in C#
 static std::multimap<double, Timer*> all;
-static std::deque<Timer*> expired_queue;
+static std::deque<Timer*> expired_lanes[TimerPriorityCount];
 static std::deque<Timer*> interval_queue;
+// Interval or pooled timer whose callback is running, it is in neither the schedule nor a lane until the callback returns
+static Timer *firing_timer = 0;
+
+Histogram Timer::lateness;
 
 static VALUE TimerClass;
 static VALUE proc_call_args[2];
@@ -85,30 +100,160 @@ static VALUE Timer_fire_bang(VALUE self)
     return Qtrue;
 }
 
-static VALUE Timer_in(VALUE self, VALUE delay_value)
+static Timer* get_reschedulable(VALUE self)
+{
+    Timer *timer = Timer::Get(self);
+    if (timer->group) rb_raise(rb_eRuntimeError, "TimerGroup members fire with their group and can't be rescheduled");
+    return timer;
+}
+
+// Moves the timer within the schedule, timers which have fired or been destroyed are scheduled again
+static VALUE Timer_reschedule(VALUE self, VALUE delay)
+{
+    get_reschedulable(self)->Reschedule(clock_time() + NUM2DBL(delay));
+    return self;
+}
+
+// Restarts the timer with the delay it was created with
+static VALUE Timer_reset(VALUE self)
+{
+    Timer *timer = get_reschedulable(self);
+    timer->Reschedule(clock_time() + timer->delay);
+    return self;
+}
+
+static VALUE Timer_postpone(VALUE self, VALUE delta)
+{
+    Timer *timer = get_reschedulable(self);
+    timer->Reschedule(timer->at + NUM2DBL(delta));
+    return self;
+}
+
+static TimerPriority priority_from_value(VALUE value)
+{
+    if (NIL_P(value)) return TimerPriority::Normal;
+    if (SYMBOL_P(value)) {
+        if (SYM2ID(value) == rb_intern("high")) return TimerPriority::High;
+        if (SYM2ID(value) == rb_intern("normal")) return TimerPriority::Normal;
+        if (SYM2ID(value) == rb_intern("low")) return TimerPriority::Low;
+    }
+    rb_raise(rb_eArgError, "priority must be :high, :normal or :low");
+    return TimerPriority::Normal;
+}
+
+static VALUE priority_to_value(TimerPriority priority)
 {
+    switch (priority) {
+    case TimerPriority::High: return ID2SYM(rb_intern("high"));
+    case TimerPriority::Low: return ID2SYM(rb_intern("low"));
+    default: return ID2SYM(rb_intern("normal"));
+    }
+}
+
+static VALUE Timer_priority(VALUE self)
+{
+    return priority_to_value(Timer::Get(self)->priority);
+}
+
+// Only affects the lane which the timer is placed in the next time it expires
+static VALUE Timer_priority_set(VALUE self, VALUE priority)
+{
+    Timer::Get(self)->priority = priority_from_value(priority);
+    return priority;
+}
+
+static VALUE Timer_in(int argc, VALUE *argv, VALUE self)
+{
+    VALUE delay_value, priority;
+    rb_scan_args(argc, argv, "11", &delay_value, &priority);
     rb_need_block();
     Log::Debug("Timer.in");
     Timer *timer = new Timer(NUM2DBL(delay_value));
-    timer->SetCallback(rb_block_proc());
-    timer->Schedule();
+    timer->priority = priority_from_value(priority);
     current_object_count++;
     // We skip calling initialize on the timer to reduce overhead
-    return timer->instance = Data_Wrap_Struct(TimerClass, Timer_mark, Timer_free, timer);
+    VALUE instance = timer->instance = Data_Wrap_Struct(TimerClass, Timer_mark, Timer_free, timer);
+    timer->SetCallback(rb_block_proc());
+    timer->Schedule();
+    RB_GC_GUARD(instance);
+    return instance;
+}
+
+// Fire-and-forget variant of Timer.in which uses a pooled timer without a ruby instance and returns an integer handle
+static VALUE Timer_after(int argc, VALUE *argv, VALUE self)
+{
+    VALUE delay_value, priority;
+    rb_scan_args(argc, argv, "11", &delay_value, &priority);
+    rb_need_block();
+    Log::Debug("Timer.after");
+    Timer *timer = TimerPool::Acquire(NUM2DBL(delay_value));
+    timer->priority = priority_from_value(priority);
+    // Pooled timers have no instance to mark the callback so it is marked by the pool
+    timer->callback_block = rb_block_proc();
+    timer->Schedule();
+    if (!timer->is_scheduled) {
+        timer->is_destroyed = true;
+        TimerPool::Release(timer);
+        return Qnil;
+    }
+    return ULL2NUM(TimerPool::Handle(timer));
 }
 
-static VALUE Timer_every(VALUE self, VALUE delay_value)
+// Proc-free variant of Timer.after which calls a method with up to TimerMaxCallArgs arguments, e.g. Timer.call_in(delay, obj, :on_timeout, conn)
+static VALUE Timer_call_in(int argc, VALUE *argv, VALUE self)
 {
+    if (argc < 3 || argc > 3 + TimerMaxCallArgs)
+        rb_raise(rb_eArgError, "wrong number of arguments (given %d, expected 3..%d)", argc, 3 + TimerMaxCallArgs);
+    ID method = rb_to_id(argv[2]);
+    Log::Debug("Timer.call_in");
+    Timer *timer = TimerPool::Acquire(NUM2DBL(argv[0]));
+    timer->SetMethodCall(argv[1], method, argc - 3, argv + 3);
+    timer->Schedule();
+    if (!timer->is_scheduled) {
+        timer->is_destroyed = true;
+        TimerPool::Release(timer);
+        return Qnil;
+    }
+    return ULL2NUM(TimerPool::Handle(timer));
+}
+
+static VALUE Timer_cancel(VALUE self, VALUE handle)
+{
+    Timer *timer = TimerPool::Find(NUM2ULL(handle));
+    if (!timer || timer->is_destroyed) return Qfalse;
+    timer->Destroy();
+    return Qtrue;
+}
+
+static VALUE Timer_every(int argc, VALUE *argv, VALUE self)
+{
+    VALUE delay_value, priority;
+    rb_scan_args(argc, argv, "11", &delay_value, &priority);
     rb_need_block();
     Log::Debug("Timer.every");
     double delay = NUM2DBL(delay_value);
     Timer *timer = new Timer(delay);
     timer->interval = delay;
-    timer->SetCallback(rb_block_proc());
-    timer->Schedule();
+    timer->priority = priority_from_value(priority);
     current_object_count++;
     // We skip calling initialize on the timer to reduce overhead
-    return timer->instance = Data_Wrap_Struct(TimerClass, Timer_mark, Timer_free, timer);
+    VALUE instance = timer->instance = Data_Wrap_Struct(TimerClass, Timer_mark, Timer_free, timer);
+    timer->SetCallback(rb_block_proc());
+    timer->Schedule();
+    RB_GC_GUARD(instance);
+    return instance;
+}
+
+static VALUE Timer_tick_budget_us(VALUE self)
+{
+    return INT2NUM((int)(tick_budget * 1000000));
+}
+
+// Normal and low priority timers which don't fit in the budget are carried over to the next tick, 0 disables the budget
+static VALUE Timer_tick_budget_us_set(VALUE self, VALUE value)
+{
+    tick_budget = NUM2INT(value) / 1000000.0;
+    return value;
 }
 
 static VALUE Timer_late_warning_us(VALUE self)
@@ -121,9 +266,28 @@ static VALUE Timer_late_warning_us_set(VALUE self, VALUE value)
     return INT2NUM(late_warning_us = NUM2INT(value));
 }
 
+static VALUE Timer_lateness(VALUE self)
+{
+    VALUE hash = rb_hash_new();
+    rb_hash_aset(hash, ID2SYM(rb_intern("count")), ULL2NUM(Timer::lateness.count));
+    rb_hash_aset(hash, ID2SYM(rb_intern("min")), LL2NUM(Timer::lateness.count ? Timer::lateness.min : 0));
+    rb_hash_aset(hash, ID2SYM(rb_intern("p50")), LL2NUM(Timer::lateness.Percentile(50)));
+    rb_hash_aset(hash, ID2SYM(rb_intern("p90")), LL2NUM(Timer::lateness.Percentile(90)));
+    rb_hash_aset(hash, ID2SYM(rb_intern("p99")), LL2NUM(Timer::lateness.Percentile(99)));
+    rb_hash_aset(hash, ID2SYM(rb_intern("p999")), LL2NUM(Timer::lateness.Percentile(99.9)));
+    rb_hash_aset(hash, ID2SYM(rb_intern("max")), LL2NUM(Timer::lateness.max));
+    return hash;
+}
+
+static VALUE Timer_reset_lateness(VALUE self)
+{
+    Timer::lateness.Reset();
+    return Qnil;
+}
+
 static VALUE Timer_stats(VALUE self)
 {
-    return rb_sprintf("Frames: %d, Empty: %d, Fires: %d, Early: %d, Late: %d, Current: %d, Objects: %d, Scheduled: %d, GC: %d, Total: %d", last_second_frame_count, last_second_empty_frames, fired_last_second_count, last_second_earliest_fire < INT_MAX ? last_second_earliest_fire : -1, last_second_latest_fire, current_timer_count, current_object_count, all.size(), current_gc_registered_count, total_count);
+    return rb_sprintf("Frames: %d, Empty: %d, Fires: %d, Early: %d, Late: %d, Current: %d, Objects: %d, Pooled: %d / %d, Scheduled: %d, GC: %d, Total: %d", last_second_frame_count, last_second_empty_frames, fired_last_second_count, last_second_earliest_fire < INT_MAX ? last_second_earliest_fire : -1, last_second_latest_fire, current_timer_count, current_object_count, (int)TimerPool::in_use_count, (int)TimerPool::Capacity(), all.size(), current_gc_registered_count, total_count);
 }
 
 void Timer::Setup()
@@ -132,9 +296,16 @@ void Timer::Setup()
     proc_call_args[1] = empty_array_value;
 
     TimerClass = rb_define_class("Timer", rb_cObject);
-    rb_define_singleton_method(TimerClass, "in", RUBY_METHOD_FUNC(Timer_in), 1);
-    rb_define_singleton_method(TimerClass, "every", RUBY_METHOD_FUNC(Timer_every), 1);
+    rb_define_singleton_method(TimerClass, "in", RUBY_METHOD_FUNC(Timer_in), -1);
+    rb_define_singleton_method(TimerClass, "after", RUBY_METHOD_FUNC(Timer_after), -1);
+    rb_define_singleton_method(TimerClass, "call_in", RUBY_METHOD_FUNC(Timer_call_in), -1);
+    rb_define_singleton_method(TimerClass, "cancel", RUBY_METHOD_FUNC(Timer_cancel), 1);
+    rb_define_singleton_method(TimerClass, "every", RUBY_METHOD_FUNC(Timer_every), -1);
     rb_define_singleton_method(TimerClass, "stats", RUBY_METHOD_FUNC(Timer_stats), 0);
+    rb_define_singleton_method(TimerClass, "lateness", RUBY_METHOD_FUNC(Timer_lateness), 0);
+    rb_define_singleton_method(TimerClass, "reset_lateness", RUBY_METHOD_FUNC(Timer_reset_lateness), 0);
+    rb_define_singleton_method(TimerClass, "tick_budget_us", RUBY_METHOD_FUNC(Timer_tick_budget_us), 0);
+    rb_define_singleton_method(TimerClass, "tick_budget_us=", RUBY_METHOD_FUNC(Timer_tick_budget_us_set), 1);
     rb_define_singleton_method(TimerClass, "late_warning_us", RUBY_METHOD_FUNC(Timer_late_warning_us), 0);
     rb_define_singleton_method(TimerClass, "late_warning_us=", RUBY_METHOD_FUNC(Timer_late_warning_us_set), 1);
     rb_define_alloc_func(TimerClass, Timer_alloc);
@@ -142,10 +313,34 @@ void Timer::Setup()
     rb_define_method(TimerClass, "expires_at", RUBY_METHOD_FUNC(Timer_expires_at), 0);
     rb_define_method(TimerClass, "destroy", RUBY_METHOD_FUNC(Timer_destroy), 0);
     rb_define_method(TimerClass, "destroyed?", RUBY_METHOD_FUNC(Timer_is_destroyed), 0);
+    rb_define_method(TimerClass, "priority", RUBY_METHOD_FUNC(Timer_priority), 0);
+    rb_define_method(TimerClass, "priority=", RUBY_METHOD_FUNC(Timer_priority_set), 1);
+    rb_define_method(TimerClass, "reschedule", RUBY_METHOD_FUNC(Timer_reschedule), 1);
+    rb_define_method(TimerClass, "reset", RUBY_METHOD_FUNC(Timer_reset), 0);
+    rb_define_method(TimerClass, "postpone", RUBY_METHOD_FUNC(Timer_postpone), 1);
     rb_define_method(TimerClass, "fire!", RUBY_METHOD_FUNC(Timer_fire_bang), 0);
 
     late_warning_us = 0;
     current_second_started_at = clock_time();
+
+    TimerPool::Setup();
+    TimerGroup::Setup();
+}
+
+VALUE Timer::Stats()
+{
+    int carried_count = 0;
+    for (int priority = 0; priority < TimerPriorityCount; priority++) carried_count += expired_lanes[priority].size();
+    VALUE hash = rb_hash_new();
+    rb_hash_aset(hash, ID2SYM(rb_intern("scheduled")), SIZET2NUM(all.size()));
+    rb_hash_aset(hash, ID2SYM(rb_intern("objects")), INT2NUM(current_object_count));
+    rb_hash_aset(hash, ID2SYM(rb_intern("pooled")), SIZET2NUM(TimerPool::in_use_count));
+    rb_hash_aset(hash, ID2SYM(rb_intern("pool_capacity")), SIZET2NUM(TimerPool::Capacity()));
+    rb_hash_aset(hash, ID2SYM(rb_intern("gc_registered")), INT2NUM(current_gc_registered_count));
+    rb_hash_aset(hash, ID2SYM(rb_intern("carried")), INT2NUM(carried_count));
+    rb_hash_aset(hash, ID2SYM(rb_intern("deferred")), ULL2NUM(deferred_count));
+    rb_hash_aset(hash, ID2SYM(rb_intern("budget_exceeded_ticks")), ULL2NUM(budget_exceeded_count));
+    return hash;
 }
 
 Timer* Timer::Get(VALUE instance)
@@ -155,8 +350,35 @@ Timer* Timer::Get(VALUE instance)
     return timer;
 }
 
+// Creates the ruby instance for a timer which was allocated natively, e.g. TimerGroup members
+VALUE Timer::Wrap(Timer *timer)
+{
+    current_object_count++;
+    return timer->instance = Data_Wrap_Struct(TimerClass, Timer_mark, Timer_free, timer);
+}
+
+void Timer::Publish(MetricsSegment *segment)
+{
+    segment->frames = total_frame_count;
+    segment->empty_frames = total_empty_frame_count;
+    segment->fires = total_fire_count;
+    segment->deferred = deferred_count;
+    segment->active_timers = current_timer_count;
+    segment->scheduled_timers = all.size();
+    segment->timer_objects = current_object_count;
+    segment->gc_registered = current_gc_registered_count;
+    segment->lateness_count = lateness.count;
+    segment->lateness_min = lateness.count ? lateness.min : 0;
+    segment->lateness_max = lateness.max;
+    memcpy(segment->lateness_buckets, lateness.buckets, sizeof(segment->lateness_buckets));
+}
+
 void Timer::Update(double now)
 {
+    int carried_count = 0;
+    for (int priority = 0; priority < TimerPriorityCount; priority++) carried_count += expired_lanes[priority].size();
+
+    int expired_count = 0;
     std::multimap<double, Timer*>::iterator it = all.begin();
     for (; it != all.end(); ++it) {
 		if (it->first > now) break;
@@ -166,15 +388,26 @@ void Timer::Update(double now)
 		//}
 		Timer *timer = it->second;
         if (!timer->is_scheduled) Log::Error("Expired timer %d has is_scheduled set to false!", timer->id);
-		expired_queue.push_back(timer);
+        // Expired timers are erased from the schedule below, so they must not be removed again if destroyed before firing
+        timer->is_scheduled = false;
+        expired_count++;
+        // A timer which was rescheduled while deferred by the tick budget is still waiting in its lane
+        if (timer->is_expired) continue;
+        timer->is_expired = true;
+        // Timers carried over from previous ticks are already at the front of their lane
+		expired_lanes[(int)timer->priority].push_back(timer);
 	}
 
     int active_count = all.size();
-    int expired_count = expired_queue.size();
 
     current_second_frame_count++;
-    if (expired_count < 1) current_second_empty_frames++;
+    total_frame_count++;
+    if (expired_count < 1) {
+        current_second_empty_frames++;
+        total_empty_frame_count++;
+    }
     fired_current_second_count += expired_count;
+    total_fire_count += expired_count;
     if (now >= current_second_started_at + 5.0)
     {
         current_second_started_at = now;
@@ -190,64 +423,101 @@ void Timer::Update(double now)
         current_second_latest_fire = 0;
     }
 
-    if (expired_count < 1) return;
+    if (expired_count < 1 && carried_count < 1) return;
 
-    Log::Debug("Update - %d / %d timers expiring", expired_count, active_count);
+    Log::Debug("Update - %d / %d timers expiring, %d carried over", expired_count, active_count, carried_count);
 
     if (expired_count < active_count)
         all.erase(all.begin(), it);
     else
         all.clear();
 
-    std::deque<Timer*>::iterator deq = expired_queue.begin();
-    while (deq != expired_queue.end()) {
-        Timer *timer = (Timer*)*deq++;
-        timer->is_scheduled = false;
+    // High priority timers always fire, lower lanes stop firing once the tick budget has been used up
+    double budget_ends_at = tick_budget ? now + tick_budget : 0;
+    uint64_t deferred_before = deferred_count;
+    for (int priority = 0; priority < TimerPriorityCount; priority++) {
+        if (!FireLane(expired_lanes[priority], priority == (int)TimerPriority::High ? 0 : budget_ends_at)) return;
+    }
+    if (deferred_count > deferred_before) budget_exceeded_count++;
+
+    now = clock_time();
+    while (!interval_queue.empty()) {
+        Timer *timer = interval_queue.front();
+        interval_queue.pop_front();
+        if (timer->is_scheduled) {
+            Log::Debug("Update - Interval rescheduled from another timers callback");
+            continue;
+        }
+        if (timer->is_destroyed) {
+            Log::Debug("Update - Interval destroyed from another timers callback");
+            timer->StoppedBeingScheduled();
+            continue;
+        }
+        Log::Debug("Update - Rescheduling interval");
+        timer->at = now + timer->interval;
+        timer->InsertIntoSchedule();
+    }
+
+    Log::Debug("Update - Done");
+}
+
+// Returns false when the reactor was stopped by one of the callbacks
+bool Timer::FireLane(std::deque<Timer*> &lane, double budget_ends_at)
+{
+    while (!lane.empty()) {
+        if (budget_ends_at && clock_time() > budget_ends_at) {
+            Log::Debug("Update - Tick budget exceeded, deferring %d timers", lane.size());
+            deferred_count += lane.size();
+            return true;
+        }
+        Timer *timer = lane.front();
+        lane.pop_front();
+        timer->is_expired = false;
         Log::Debug("Update - Expired");
-        if (timer->interval) {
+        if (timer->is_scheduled) {
+            Log::Debug("Update - Expired timer rescheduled before firing");
+        } else if (timer->is_destroyed) {
+            Log::Debug("Update - Expired timer destroyed from another timers callback");
+            timer->StoppedBeingScheduled();
+        } else if (timer->interval) {
             //Log::Debug("Update - Firing: %s", RSTRING_PTR(rb_inspect(timer->callback_block)));
+            firing_timer = timer;
             timer->Fire();
+            firing_timer = 0;
             if (timer->is_destroyed)
             {
                 Log::Debug("Update - Interval destroyed from it's own callback");
                 timer->StoppedBeingScheduled();
             }
-            else
+            else if (!timer->is_scheduled)
             {
                 Log::Debug("Update - Adding to interval queue");
                 interval_queue.push_back(timer);
             }
+        } else if (timer->is_pooled) {
+            // Pooled timers are released back to the pool once they stop being scheduled so they must fire first
+            timer->is_destroyed = true;
+            firing_timer = timer;
+            timer->Fire();
+            firing_timer = 0;
+            timer->StoppedBeingScheduled();
         } else {
             timer->is_destroyed = true;
             timer->StoppedBeingScheduled();
             timer->Fire();
         }
-        if (!actuator->is_running) break;
+        if (!actuator->is_running) return false;
     }
-    expired_queue.clear();
-
-    if (!actuator->is_running) return;
-
-    now = clock_time();
-    deq = interval_queue.begin();
-    while (deq != interval_queue.end()) {
-        Timer *timer = (Timer*)*deq++;
-        if (timer->is_destroyed) {
-            Log::Debug("Update - Interval destroyed from another timers callback");
-            timer->StoppedBeingScheduled();
-            continue;
-        }
-        Log::Debug("Update - Rescheduling interval");
-        timer->at = now + timer->interval;
-        timer->InsertIntoSchedule();
-    }
-    interval_queue.clear();
-
-    Log::Debug("Update - Done");
+    return true;
 }
 
 double Timer::GetNextEventTime()
 {
+    // Timers deferred by the tick budget have already expired so the reactor must not sleep. Carried timers which were
+    // rescheduled are also in the schedule with a future time, so they can't stand in for the rest of their lane.
+    for (int priority = 0; priority < TimerPriorityCount; priority++) {
+        for (Timer *timer : expired_lanes[priority]) if (!timer->is_scheduled) return timer->at;
+    }
     return all.empty() ? 0 : all.begin()->first;
 }
 
@@ -258,9 +528,23 @@ Timer::Timer()
     at = 0;
     interval = 0;
     callback_block = 0;
+    native_callback = 0;
+    native_data = 0;
+    call_receiver = 0;
+    call_method = 0;
+    call_argc = 0;
     fiber = 0;
     is_scheduled = false;
     is_destroyed = false;
+    is_expired = false;
+    is_gc_registered = false;
+    is_pooled = false;
+    slot = 0;
+    group = 0;
+    group_prev = 0;
+    group_next = 0;
+    group_bucket = 0;
+    priority = TimerPriority::Normal;
     instance = 0;
     inspected = 0;
     current_timer_count++;
@@ -274,14 +558,9 @@ Timer::Timer(double initial_delay) : Timer()
 
 Timer::~Timer()
 {
-    if (callback_block) {
-        //TODO: Profile overhead of unregister when loaded (walks the entire global object list)
-        rb_gc_unregister_address(&callback_block);
-        callback_block = 0;
-        if (inspected) {
-            free(inspected);
-            inspected = 0;
-        }
+    if (inspected) {
+        free(inspected);
+        inspected = 0;
     }
     if (is_scheduled) Log::Error("Timer freed while still scheduled");
     if (!is_destroyed) Log::Error("Timer freed before being destroyed");
@@ -300,6 +579,10 @@ void Timer::Destroy()
     if (is_destroyed) return;
     Log::Debug("Destroy");
     is_destroyed = true;
+    if (group) {
+        group->Leave(this);
+        return;
+    }
     Remove();
 }
 
@@ -317,10 +600,26 @@ void Timer::Schedule()
     StartedBeingScheduled();
 }
 
+// Moves the node in the schedule instead of allocating a new timer, which also works from the timers own callback
+void Timer::Reschedule(double new_at)
+{
+    Log::Debug("Reschedule");
+    if (!is_scheduled && all.size() > MaxOutstandingTimers) {
+        Log::Warn("Error: There are %d / %d active timers!", all.size(), MaxOutstandingTimers);
+        return;
+    }
+    RemoveFromSchedule();
+    is_destroyed = false;
+    at = new_at;
+    InsertIntoSchedule();
+    StartedBeingScheduled();
+}
+
 void Timer::Remove()
 {
     Log::Debug("Remove");
-    if (RemoveFromSchedule())
+    // Expired timers are still referenced by their lane until they are popped, which releases them if destroyed
+    if (RemoveFromSchedule() && !is_expired)
         StoppedBeingScheduled();
 }
 
@@ -329,6 +628,7 @@ void Timer::InsertIntoSchedule()
     if (is_scheduled) return;
     Log::Debug("InsertIntoSchedule");
     is_scheduled = true;
+    // Multimap inserts at the upper bound so timers with the same deadline fire in the order they were scheduled
     iterator = all.insert(std::make_pair(at, this));
 }
 
@@ -343,14 +643,24 @@ bool Timer::RemoveFromSchedule()
 
 void Timer::StartedBeingScheduled()
 {
+    // Pooled timers have no ruby instance to keep alive
+    // Timers which are rescheduled while waiting to fire are still registered
+    if (is_pooled || is_gc_registered) return;
     Log::Debug("StartedBeingScheduled");
+    is_gc_registered = true;
     rb_gc_register_address(&instance);
     current_gc_registered_count++;
 }
 
 void Timer::StoppedBeingScheduled()
 {
+    if (is_pooled) {
+        TimerPool::Release(this);
+        return;
+    }
+    if (!is_gc_registered) return;
     Log::Debug("StoppedBeingScheduled");
+    is_gc_registered = false;
     rb_gc_unregister_address(&instance);
     current_gc_registered_count--;
     Log::Debug("GC pointer count: %d", current_gc_registered_count);
@@ -359,14 +669,14 @@ void Timer::StoppedBeingScheduled()
 void Timer::SetCallback(VALUE block)
 {
     Log::Debug("SetCallback");
-    if (callback_block) {
-        rb_gc_unregister_address(&callback_block);
+    if (inspected) {
         free(inspected);
         inspected = 0;
     }
+    // Callbacks are marked by Timer_mark rather than registered as GC roots, otherwise a callback which
+    // references its own timer keeps the timer alive forever. The instance is a GC root while scheduled.
     callback_block = block;
     if (block) {
-        rb_gc_register_address(&callback_block);
         //VALUE obj = rb_inspect(block);
         //inspected = (char*)malloc(RSTRING_LEN(obj)+1);
         //strcpy(inspected, RSTRING_PTR(obj));
@@ -378,6 +688,22 @@ void Timer::SetFiber(VALUE current_fiber)
     fiber = current_fiber;
 }
 
+// Native callbacks are used to drive the scheduler without calling into ruby (see bench/native)
+void Timer::SetNativeCallback(TimerCallback callback, void *data)
+{
+    native_callback = callback;
+    native_data = data;
+}
+
+// Only used by pooled timers since the receiver and arguments are marked by the pool
+void Timer::SetMethodCall(VALUE receiver, ID method, int argc, const VALUE *argv)
+{
+    call_receiver = receiver;
+    call_method = method;
+    call_argc = argc;
+    for (int i = 0; i < argc; i++) call_args[i] = argv[i];
+}
+
 void Timer::ExpireImmediately()
 {
     if (is_destroyed || !is_scheduled) return;
@@ -387,7 +713,7 @@ void Timer::ExpireImmediately()
         Fire();
         if (is_destroyed) {
             StoppedBeingScheduled();
-        } else {
+        } else if (!is_scheduled) {
             at = clock_time() + interval;
             InsertIntoSchedule();
         }
@@ -408,6 +734,22 @@ static VALUE fire_rescue(VALUE _, VALUE errinfo)
     return Qnil;
 }
 
+static VALUE fire_method_call(VALUE data)
+{
+    Timer *timer = (Timer*)data;
+    return rb_funcallv(timer->call_receiver, timer->call_method, timer->call_argc, timer->call_args);
+}
+
+double Timer::TrackLateness(double now)
+{
+    double late_us = (double)((now - at) * 1000000);
+    if ((int)late_us < current_second_earliest_fire) current_second_earliest_fire = (int)late_us;
+    if ((int)late_us > current_second_latest_fire) current_second_latest_fire = (int)late_us;
+    lateness.Record((int64_t)late_us);
+    if (late_us > 0) GcMonitor::TrackLateFire(at, now, late_us);
+    return late_us;
+}
+
 void Timer::Fire()
 {
     double before_call = clock_time();
@@ -415,16 +757,24 @@ void Timer::Fire()
     double before_resume;
     if (callback_block)
     {
-        double late_us = (double)((before_call - at) * 1000000);
-        if ((int)late_us < current_second_earliest_fire) current_second_earliest_fire = (int)late_us;
-        if ((int)late_us > current_second_latest_fire) current_second_latest_fire = (int)late_us;
+        double late_us = TrackLateness(before_call);
         if (late_warning_us && late_us > late_warning_us) {
-            Log::Warn("Firing %.2f us late - %d active timers, %d fired last second", late_us, all.size(), fired_last_second_count);
+            Log::Warn("Firing %.2f us late (%.2f us in GC) - %d active timers, %d fired last second", late_us, GcMonitor::Overlap(at, before_call) * 1000000, all.size(), fired_last_second_count);
         }
         int rescue_state;
         proc_call_args[0] = callback_block;
         rb_rescue(RUBY_METHOD_FUNC(rb_proc_call_fast), callback_block, RUBY_METHOD_FUNC(fire_rescue), Qnil);
     }
+    else if (call_method)
+    {
+        TrackLateness(before_call);
+        rb_rescue(RUBY_METHOD_FUNC(fire_method_call), (VALUE)this, RUBY_METHOD_FUNC(fire_rescue), Qnil);
+    }
+    else if (native_callback)
+    {
+        TrackLateness(before_call);
+        native_callback(this, native_data);
+    }
     else if (fiber)
     {
         Log::Warn("[Fire] Resuming fiber %.2f us late", (double)((before_call - at) * 1000000));
@@ -443,8 +793,56 @@ void Timer::Fire()
     //puts("[FireTimer] call took %.2f us, resume: %.2f us, resume_total: %.2f us, late: %.2f us", (double)((after_call - before_call) * 1000000), (double)((sleep_ended_at - before_resume) * 1000000) - 0.3, (double)((after_call - before_resume) * 1000000) - 0.3, (double)((sleep_ended_at - at) * 1000000) - 0.3);
 }
 
+// Releases every timer which is still scheduled or waiting to fire so that nothing is left behind when the reactor
+// stops. Timers with a ruby instance are destroyed and stop being GC roots, they can be rescheduled after a restart.
 void Timer::Clear()
 {
-    //TODO: Actually clean up and free all timers and next_tick callbacks
+    std::vector<Timer*> timers;
+    timers.reserve(all.size());
+    for (auto &entry : all) timers.push_back(entry.second);
     all.clear();
-}
\ No newline at end of file
+    // Expired timers which were rescheduled are in both the schedule and their lane
+    for (int priority = 0; priority < TimerPriorityCount; priority++) {
+        for (Timer *timer : expired_lanes[priority]) if (!timer->is_scheduled) timers.push_back(timer);
+        std::deque<Timer*>().swap(expired_lanes[priority]);
+    }
+    // Intervals which fired in a tick that was cut short by Actuator.stop are still waiting to be rescheduled
+    for (Timer *timer : interval_queue) if (!timer->is_scheduled && !timer->is_expired) timers.push_back(timer);
+    std::deque<Timer*>().swap(interval_queue);
+    // A callback which raised left its timer registered as a GC root or holding its pool slot
+    if (firing_timer && !firing_timer->is_scheduled) timers.push_back(firing_timer);
+    firing_timer = 0;
+    for (Timer *timer : timers) {
+        timer->is_scheduled = false;
+        timer->is_expired = false;
+        timer->is_destroyed = true;
+        // Timers created by Actuator.sleep have no ruby instance and are only freed after resuming their fiber
+        bool is_owned = timer->fiber && !timer->instance && !timer->is_pooled;
+        timer->StoppedBeingScheduled();
+        if (is_owned) delete timer;
+    }
+}
+
+// Native memory held by ruby and internal timers, the schedule and the expired lanes (pooled timers are in TimerPool)
+size_t Timer::MemoryUsage()
+{
+    size_t lane_count = interval_queue.size();
+    for (int priority = 0; priority < TimerPriorityCount; priority++) lane_count += expired_lanes[priority].size();
+    // Multimap nodes hold the entry along with the color and parent, left and right pointers
+    size_t node_size = sizeof(std::pair<const double, Timer*>) + 4 * sizeof(void*);
+    return (current_timer_count - TimerPool::in_use_count) * sizeof(Timer) + all.size() * node_size + lane_count * sizeof(Timer*);
+}
+
+// Counters start from zero in forked children
+void Timer::ResetStats()
+{
+    fired_current_second_count = fired_last_second_count = 0;
+    current_second_frame_count = last_second_frame_count = 0;
+    current_second_empty_frames = last_second_empty_frames = 0;
+    current_second_earliest_fire = last_second_earliest_fire = INT_MAX;
+    current_second_latest_fire = last_second_latest_fire = 0;
+    current_second_started_at = clock_time();
+    budget_exceeded_count = deferred_count = 0;
+    total_frame_count = total_empty_frame_count = total_fire_count = 0;
+    lateness.Reset();
+}
@@ -1,9 +1,30 @@
 #include <iostream>
+#include <deque>
 #include <map>
 #include <ruby.h>
 
 #include "actuator.h"
 #include "clock.h"
+#include "histogram.h"
+
+class Timer;
+class TimerGroup;
+struct MetricsSegment;
+
+// Expired timers fire in priority order, only high priority timers are exempt from the tick budget
+enum class TimerPriority
+{
+    High,
+    Normal,
+    Low
+};
+
+const int TimerPriorityCount = 3;
+
+// Maximum number of arguments stored natively by Timer.call_in
+const int TimerMaxCallArgs = 3;
+
+typedef void (*TimerCallback)(Timer *timer, void *data);
 
 class Timer {
 public:
@@ -14,9 +35,25 @@ public:
     VALUE fiber;
     VALUE instance = 0;
     VALUE callback_block;
+    TimerCallback native_callback;
+    void *native_data;
+    VALUE call_receiver;
+    ID call_method;
+    int call_argc;
+    VALUE call_args[TimerMaxCallArgs];
     std::multimap<double, Timer*>::iterator iterator;
     bool is_scheduled;
     bool is_destroyed;
+    bool is_expired;
+    bool is_gc_registered;
+    bool is_pooled;
+    uint32_t slot;
+    // Members of a TimerGroup are linked into one of its buckets instead of being scheduled individually
+    TimerGroup *group;
+    Timer *group_prev;
+    Timer *group_next;
+    uint32_t group_bucket;
+    TimerPriority priority;
     char* inspected;
 
     Timer();
@@ -25,21 +62,33 @@ public:
     void Destroy();
     void SetDelay(double initial_delay);
     void Schedule();
+    void Reschedule(double new_at);
     void Remove();
     void SetCallback(VALUE callback);
     void SetFiber(VALUE current_fiber);
+    void SetNativeCallback(TimerCallback callback, void *data);
+    void SetMethodCall(VALUE receiver, ID method, int argc, const VALUE *argv);
     void SetInitialDelay(VALUE delay);
     void ExpireImmediately();
     void Fire();
 
+    static Histogram lateness;
+
     static void Setup();
     static Timer* Get(VALUE instance);
+    static VALUE Wrap(Timer *timer);
     static void Clear();
+    static void ResetStats();
+    static size_t MemoryUsage();
     static void Update(double now);
     static double GetNextEventTime();
+    static VALUE Stats();
+    static void Publish(MetricsSegment *segment);
 private:
+    static bool FireLane(std::deque<Timer*> &lane, double budget_ends_at);
     void InsertIntoSchedule();
     bool RemoveFromSchedule();
+    double TrackLateness(double now);
     void StartedBeingScheduled();
     void StoppedBeingScheduled();
 };
\ No newline at end of file
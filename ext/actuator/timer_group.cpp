@@ -0,0 +1,266 @@
+#include "reactor.h"
+#include "timer_group.h"
+#include <set>
+
+// Bucket index of members which are waiting in the firing list
+static const uint32_t FiringBucket = UINT32_MAX;
+
+static VALUE TimerGroupClass;
+// Groups whose timer is running, they are GC roots until their timer stops or the reactor is torn down
+static std::set<TimerGroup*> running_groups;
+static size_t total_bucket_count = 0;
+
+static void TimerGroup_mark(TimerGroup *group)
+{
+    group->Mark();
+}
+
+static void TimerGroup_free(TimerGroup *group)
+{
+    delete group;
+}
+
+static VALUE TimerGroup_alloc(VALUE klass)
+{
+    return Data_Wrap_Struct(klass, TimerGroup_mark, TimerGroup_free, 0);
+}
+
+// TimerGroup.new(period, spread=period, buckets=64) - members first fire between period - spread and period after joining
+static VALUE TimerGroup_initialize(int argc, VALUE *argv, VALUE self)
+{
+    VALUE period_value, spread_value, buckets_value;
+    rb_scan_args(argc, argv, "12", &period_value, &spread_value, &buckets_value);
+    double period = NUM2DBL(period_value);
+    if (period <= 0) rb_raise(rb_eArgError, "period must be greater than 0");
+    double spread = NIL_P(spread_value) ? period : NUM2DBL(spread_value);
+    if (spread < 0 || spread > period) rb_raise(rb_eArgError, "spread must be between 0 and the period");
+    uint32_t buckets = NIL_P(buckets_value) ? TimerGroup::DefaultBucketCount : NUM2UINT(buckets_value);
+    if (buckets < 1) rb_raise(rb_eArgError, "buckets must be at least 1");
+    TimerGroup *group = new TimerGroup(period, spread, buckets);
+    group->instance = self;
+    DATA_PTR(self) = group;
+    return self;
+}
+
+static VALUE TimerGroup_every(VALUE self)
+{
+    rb_need_block();
+    return TimerGroup::Get(self)->Join(rb_block_proc())->instance;
+}
+
+static VALUE TimerGroup_size(VALUE self)
+{
+    return SIZET2NUM(TimerGroup::Get(self)->size);
+}
+
+static VALUE TimerGroup_period(VALUE self)
+{
+    return DBL2NUM(TimerGroup::Get(self)->period);
+}
+
+static VALUE TimerGroup_spread(VALUE self)
+{
+    return DBL2NUM(TimerGroup::Get(self)->spread);
+}
+
+void TimerGroup::Setup()
+{
+    TimerGroupClass = rb_define_class("TimerGroup", rb_cObject);
+    rb_define_alloc_func(TimerGroupClass, TimerGroup_alloc);
+    rb_define_method(TimerGroupClass, "initialize", RUBY_METHOD_FUNC(TimerGroup_initialize), -1);
+    rb_define_method(TimerGroupClass, "every", RUBY_METHOD_FUNC(TimerGroup_every), 0);
+    rb_define_method(TimerGroupClass, "size", RUBY_METHOD_FUNC(TimerGroup_size), 0);
+    rb_define_method(TimerGroupClass, "period", RUBY_METHOD_FUNC(TimerGroup_period), 0);
+    rb_define_method(TimerGroupClass, "spread", RUBY_METHOD_FUNC(TimerGroup_spread), 0);
+}
+
+TimerGroup* TimerGroup::Get(VALUE instance)
+{
+    TimerGroup *group;
+    Data_Get_Struct(instance, TimerGroup, group);
+    if (!group) rb_raise(rb_eRuntimeError, "TimerGroup instance has not been initialized");
+    return group;
+}
+
+TimerGroup::TimerGroup(double group_period, double phase_spread, uint32_t buckets)
+{
+    period = group_period;
+    spread = phase_spread;
+    bucket_count = buckets;
+    size = 0;
+    instance = 0;
+    this->buckets.resize(bucket_count, Bucket{0, 0});
+    total_bucket_count += bucket_count;
+    firing = Bucket{0, 0};
+    cursor = 0;
+    spread_buckets = (uint32_t)(spread / period * bucket_count + 0.5);
+    if (spread_buckets < 1) spread_buckets = 1;
+    if (spread_buckets > bucket_count) spread_buckets = bucket_count;
+    next_phase = 0;
+    is_gc_registered = false;
+    timer = new Timer(period / bucket_count);
+    timer->interval = period / bucket_count;
+    timer->SetNativeCallback(TickCallback, this);
+    // The group timer only starts being scheduled once the first member joins
+    timer->is_destroyed = true;
+}
+
+TimerGroup::~TimerGroup()
+{
+    // Members are detached when the reactor is torn down, this only guards against members which are collected in the
+    // same sweep as their group leaving a group which has already been freed
+    for (uint32_t index = 0; index < bucket_count; index++) Detach(buckets[index]);
+    Detach(firing);
+    timer->Destroy();
+    delete timer;
+    total_bucket_count -= bucket_count;
+}
+
+Timer* TimerGroup::Join(VALUE callback)
+{
+    Timer *member = new Timer();
+    member->interval = period;
+    member->group = this;
+    VALUE member_instance = Timer::Wrap(member);
+    member->SetCallback(callback);
+    // The bucket which fires last is a full period away, members are spread round robin across the buckets before it
+    uint32_t offset = bucket_count - 1 - next_phase;
+    next_phase = (next_phase + 1) % spread_buckets;
+    uint32_t index = (cursor + offset) % bucket_count;
+    Append(buckets[index], member, index);
+    size++;
+    if (!timer->is_scheduled && !timer->is_expired) {
+        StartedRunning();
+        timer->Reschedule(clock_time() + timer->interval);
+    }
+    RB_GC_GUARD(member_instance);
+    return member;
+}
+
+void TimerGroup::Leave(Timer *member)
+{
+    if (member->group_bucket == FiringBucket)
+        Unlink(firing, member);
+    else
+        Unlink(buckets[member->group_bucket], member);
+    member->group = 0;
+    size--;
+}
+
+void TimerGroup::Mark()
+{
+    for (uint32_t index = 0; index < bucket_count; index++) {
+        for (Timer *member = buckets[index].head; member; member = member->group_next) rb_gc_mark(member->instance);
+    }
+    for (Timer *member = firing.head; member; member = member->group_next) rb_gc_mark(member->instance);
+}
+
+// The group is a GC root while its timer is running so that members are marked without registering each of them
+void TimerGroup::StartedRunning()
+{
+    if (is_gc_registered) return;
+    rb_gc_register_address(&instance);
+    is_gc_registered = true;
+    running_groups.insert(this);
+}
+
+void TimerGroup::StoppedRunning()
+{
+    if (!is_gc_registered) return;
+    rb_gc_unregister_address(&instance);
+    is_gc_registered = false;
+    running_groups.erase(this);
+}
+
+// Members of running groups are destroyed when the reactor is torn down, the group timers are released by Timer::Clear
+void TimerGroup::Clear()
+{
+    std::set<TimerGroup*> groups;
+    groups.swap(running_groups);
+    for (TimerGroup *group : groups) {
+        for (uint32_t index = 0; index < group->bucket_count; index++) group->Detach(group->buckets[index]);
+        group->Detach(group->firing);
+        group->size = 0;
+        group->next_phase = 0;
+        rb_gc_unregister_address(&group->instance);
+        group->is_gc_registered = false;
+    }
+}
+
+size_t TimerGroup::MemoryUsage()
+{
+    return total_bucket_count * sizeof(Bucket) + running_groups.size() * (sizeof(TimerGroup*) + 4 * sizeof(void*));
+}
+
+void TimerGroup::TickCallback(Timer *timer, void *data)
+{
+    ((TimerGroup*)data)->Tick();
+}
+
+void TimerGroup::Tick()
+{
+    if (!size) {
+        // Stopping from the next tick instead of when the last member leaves keeps the group alive until its timer
+        // has been removed from the schedule
+        timer->Destroy();
+        StoppedRunning();
+        return;
+    }
+    // Buckets which were due while the reactor was busy fire in the same tick so that members keep their period even
+    // when the bucket interval is shorter than a reactor tick
+    double at = timer->at;
+    double late = clock_time() - at;
+    uint32_t due = late > 0 ? (uint32_t)(late / timer->interval) + 1 : 1;
+    if (due > bucket_count) due = bucket_count;
+    for (; due > 0; due--, at += timer->interval) {
+        uint32_t index = cursor;
+        cursor = (cursor + 1) % bucket_count;
+        if (!buckets[index].head) continue;
+        // Members are moved to the firing list first so that members which join this bucket from a callback wait a full period
+        firing = buckets[index];
+        buckets[index] = Bucket{0, 0};
+        for (Timer *member = firing.head; member; member = member->group_next) member->group_bucket = FiringBucket;
+        while (Timer *member = firing.head) {
+            Unlink(firing, member);
+            // Members are put back before firing so that they can destroy themselves from their callback
+            Append(buckets[index], member, index);
+            member->at = at;
+            member->Fire();
+            if (!actuator->is_running) return;
+        }
+    }
+}
+
+void TimerGroup::Append(Bucket &bucket, Timer *member, uint32_t index)
+{
+    member->group_bucket = index;
+    member->group_prev = bucket.tail;
+    member->group_next = 0;
+    if (bucket.tail)
+        bucket.tail->group_next = member;
+    else
+        bucket.head = member;
+    bucket.tail = member;
+}
+
+void TimerGroup::Detach(Bucket &bucket)
+{
+    for (Timer *member = bucket.head; member; member = member->group_next) {
+        member->group = 0;
+        member->is_destroyed = true;
+    }
+    bucket = Bucket{0, 0};
+}
+
+void TimerGroup::Unlink(Bucket &bucket, Timer *member)
+{
+    if (member->group_prev)
+        member->group_prev->group_next = member->group_next;
+    else
+        bucket.head = member->group_next;
+    if (member->group_next)
+        member->group_next->group_prev = member->group_prev;
+    else
+        bucket.tail = member->group_prev;
+    member->group_prev = member->group_next = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef ACTUATOR_TIMER_GROUP_H
+#define ACTUATOR_TIMER_GROUP_H
+
+#include <stdint.h>
+#include <vector>
+#include <ruby.h>
+
+class Timer;
+
+// Interval timers which share the same period, e.g. per-session heartbeats.
+// Members are kept in a ring of FIFO buckets and the group only has a single schedule entry which fires one bucket
+// every period / bucket_count seconds, so joining, leaving and firing a member are all O(1).
+class TimerGroup {
+public:
+    static const uint32_t DefaultBucketCount = 64;
+
+    double period;
+    double spread;
+    uint32_t bucket_count;
+    size_t size;
+    VALUE instance;
+
+    TimerGroup(double group_period, double phase_spread, uint32_t buckets);
+    ~TimerGroup();
+    Timer* Join(VALUE callback);
+    void Leave(Timer *member);
+    void Mark();
+
+    static void Setup();
+    static TimerGroup* Get(VALUE instance);
+    static void Clear();
+    static size_t MemoryUsage();
+private:
+    struct Bucket {
+        Timer *head;
+        Timer *tail;
+    };
+
+    std::vector<Bucket> buckets;
+    // Members which are waiting to fire in the current tick
+    Bucket firing;
+    uint32_t cursor;
+    uint32_t spread_buckets;
+    uint32_t next_phase;
+    bool is_gc_registered;
+    Timer *timer;
+
+    void Tick();
+    void Append(Bucket &bucket, Timer *member, uint32_t index);
+    void Unlink(Bucket &bucket, Timer *member);
+    void Detach(Bucket &bucket);
+    void StartedRunning();
+    void StoppedRunning();
+
+    static void TickCallback(Timer *timer, void *data);
+};
+
+#endif
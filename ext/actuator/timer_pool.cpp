@@ -0,0 +1,103 @@
+#include <new>
+#include "reactor.h"
+#include "timer_pool.h"
+
+size_t TimerPool::in_use_count = 0;
+
+static std::vector<Timer*> slabs;
+static std::vector<uint32_t> free_slots;
+static std::vector<bool> slot_in_use;
+static VALUE pool_root = Qnil;
+
+static Timer* slot_timer(uint32_t slot)
+{
+    return slabs[slot / TimerPool::SlabSize] + slot % TimerPool::SlabSize;
+}
+
+void TimerPool::Setup()
+{
+    // Ruby doesn't call the mark function of data objects with a null pointer
+    pool_root = Data_Wrap_Struct(rb_cObject, Mark, 0, &slabs);
+    rb_gc_register_mark_object(pool_root);
+}
+
+Timer* TimerPool::Acquire(double delay)
+{
+    if (free_slots.empty()) Grow();
+    uint32_t slot = free_slots.back();
+    free_slots.pop_back();
+    Timer *timer = new (slot_timer(slot)) Timer(delay);
+    timer->is_pooled = true;
+    timer->slot = slot;
+    slot_in_use[slot] = true;
+    in_use_count++;
+    return timer;
+}
+
+void TimerPool::Release(Timer *timer)
+{
+    uint32_t slot = timer->slot;
+    timer->~Timer();
+    slot_in_use[slot] = false;
+    free_slots.push_back(slot);
+    in_use_count--;
+}
+
+// Handles combine the slot with the timer id so that a handle can't cancel a later timer which reused the slot
+uint64_t TimerPool::Handle(Timer *timer)
+{
+    return ((uint64_t)timer->slot << 32) | (uint32_t)timer->id;
+}
+
+Timer* TimerPool::Find(uint64_t handle)
+{
+    uint32_t slot = (uint32_t)(handle >> 32);
+    if (slot >= slot_in_use.size() || !slot_in_use[slot]) return 0;
+    Timer *timer = slot_timer(slot);
+    return (uint32_t)timer->id == (uint32_t)handle ? timer : 0;
+}
+
+size_t TimerPool::Capacity()
+{
+    return slabs.size() * SlabSize;
+}
+
+// Frees the slabs once every pooled timer has been released, handles from before are no longer found
+void TimerPool::Clear()
+{
+    if (in_use_count) {
+        Log::Warn("[TimerPool] %d pooled timers are still in use, keeping %d slabs", (int)in_use_count, (int)slabs.size());
+        return;
+    }
+    for (Timer *slab : slabs) ::operator delete(slab);
+    std::vector<Timer*>().swap(slabs);
+    std::vector<uint32_t>().swap(free_slots);
+    std::vector<bool>().swap(slot_in_use);
+}
+
+size_t TimerPool::MemoryUsage()
+{
+    return slabs.size() * SlabSize * sizeof(Timer) + free_slots.capacity() * sizeof(uint32_t) + slot_in_use.capacity() / 8;
+}
+
+void TimerPool::Grow()
+{
+    uint32_t first_slot = slabs.size() * SlabSize;
+    slabs.push_back(static_cast<Timer*>(::operator new(sizeof(Timer) * SlabSize)));
+    slot_in_use.resize(first_slot + SlabSize, false);
+    // Slots are handed out from the back so push them in reverse to use lower slots first
+    for (uint32_t slot = first_slot + SlabSize; slot > first_slot; slot--) free_slots.push_back(slot - 1);
+}
+
+void TimerPool::Mark(void *data)
+{
+    for (uint32_t slot = 0; slot < slot_in_use.size(); slot++) {
+        if (!slot_in_use[slot]) continue;
+        Timer *timer = slot_timer(slot);
+        if (timer->callback_block) rb_gc_mark(timer->callback_block);
+        if (timer->call_method) {
+            rb_gc_mark(timer->call_receiver);
+            for (int i = 0; i < timer->call_argc; i++) rb_gc_mark(timer->call_args[i]);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef ACTUATOR_TIMER_POOL_H
+#define ACTUATOR_TIMER_POOL_H
+
+#include <stdint.h>
+#include <vector>
+#include <ruby.h>
+
+class Timer;
+
+// Slab allocator for fire-and-forget timers which have no ruby instance.
+// Pooled timers have no ruby instance to act as a GC root, the pool marks the callbacks of live slots instead.
+class TimerPool {
+public:
+    static const uint32_t SlabSize = 1024;
+
+    static size_t in_use_count;
+
+    static void Setup();
+    static Timer* Acquire(double delay);
+    static void Release(Timer *timer);
+    static Timer* Find(uint64_t handle);
+    static uint64_t Handle(Timer *timer);
+    static size_t Capacity();
+    static void Clear();
+    static size_t MemoryUsage();
+private:
+    static void Grow();
+    static void Mark(void *data);
+};
+
+#endif
@@ -0,0 +1,223 @@
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include "reactor.h"
+#include "watchdog.h"
+#include <ruby/debug.h>
+
+std::atomic<uint64_t> Watchdog::heartbeat(0);
+std::atomic<bool> Watchdog::is_idle(true);
+double Watchdog::threshold = 0;
+uint64_t Watchdog::stall_count = 0;
+
+static std::thread *thread = 0;
+static std::mutex mutex;
+static std::condition_variable stop_requested;
+static bool is_stopping = false;
+static std::atomic<int64_t> threshold_ns(0);
+// Set by the watchdog thread when it detects a stall, read by ruby once the postponed job runs
+static std::atomic<int64_t> stalled_since_ns(0);
+
+// Stall which has been captured but hasn't ended yet, finished by the next reactor tick
+static VALUE pending_stall = Qnil;
+// Worst stalls ordered by duration
+static VALUE offenders = Qnil;
+
+#ifdef HAVE_RB_POSTPONED_JOB_PREREGISTER
+static rb_postponed_job_handle_t capture_job;
+#endif
+
+static int64_t steady_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static VALUE current_job_info(VALUE info)
+{
+    VALUE job = rb_funcall(rb_fiber_current(), rb_intern("job"), 0);
+    if (NIL_P(job)) return Qnil;
+    rb_hash_aset(info, ID2SYM(rb_intern("job_id")), rb_funcall(job, rb_intern("id"), 0));
+    rb_hash_aset(info, ID2SYM(rb_intern("whois")), rb_funcall(job, rb_intern("whois"), 0));
+    return Qnil;
+}
+
+// Runs on the reactor thread at the next interrupt check, which is still inside the stalled fiber
+static void capture_stall(void *data)
+{
+    int64_t stalled_since = stalled_since_ns.load();
+    if (!stalled_since || !NIL_P(pending_stall)) return;
+    double elapsed_ms = (steady_now_ns() - stalled_since) / 1000000.0;
+    VALUE info = rb_hash_new();
+    rb_hash_aset(info, ID2SYM(rb_intern("job_id")), Qnil);
+    rb_hash_aset(info, ID2SYM(rb_intern("whois")), Qnil);
+    int state = 0;
+    rb_protect(current_job_info, info, &state);
+    if (state) rb_set_errinfo(Qnil);
+    VALUE backtrace = rb_make_backtrace();
+    rb_hash_aset(info, ID2SYM(rb_intern("backtrace")), backtrace);
+    rb_hash_aset(info, ID2SYM(rb_intern("detected_after_ms")), DBL2NUM(elapsed_ms));
+    pending_stall = info;
+    Watchdog::stall_count++;
+
+    VALUE job_id = rb_hash_aref(info, ID2SYM(rb_intern("job_id")));
+    VALUE whois = rb_inspect(rb_hash_aref(info, ID2SYM(rb_intern("whois"))));
+    VALUE lines = rb_ary_join(backtrace, rb_str_new_cstr("\n  "));
+    Log::Warn("[Watchdog] Reactor stalled for %.1f ms by job %s (%s)\n  %s", elapsed_ms,
+              NIL_P(job_id) ? "-" : RSTRING_PTR(rb_obj_as_string(job_id)), RSTRING_PTR(whois), RSTRING_PTR(lines));
+}
+
+static void fiber_switch_hook(rb_event_flag_t event, VALUE data, VALUE self, ID method, VALUE klass)
+{
+    Watchdog::Beat();
+}
+
+static void run()
+{
+    uint64_t last_beat = Watchdog::heartbeat.load();
+    int64_t last_change_ns = steady_now_ns();
+    bool is_reported = false;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!is_stopping) {
+        int64_t stall_threshold_ns = threshold_ns.load();
+        // Polling at a quarter of the threshold reports stalls at most 25% late
+        int64_t poll_ns = stall_threshold_ns / 4 > 1000000 ? stall_threshold_ns / 4 : 1000000;
+        stop_requested.wait_for(lock, std::chrono::nanoseconds(poll_ns));
+        if (is_stopping) break;
+        uint64_t beat = Watchdog::heartbeat.load();
+        int64_t now_ns = steady_now_ns();
+        if (beat != last_beat || Watchdog::is_idle.load()) {
+            last_beat = beat;
+            last_change_ns = now_ns;
+            is_reported = false;
+            continue;
+        }
+        if (is_reported || now_ns - last_change_ns < stall_threshold_ns) continue;
+        is_reported = true;
+        stalled_since_ns.store(last_change_ns);
+#ifdef HAVE_RB_POSTPONED_JOB_PREREGISTER
+        rb_postponed_job_trigger(capture_job);
+#endif
+    }
+}
+
+static VALUE Actuator_stall_threshold(VALUE klass)
+{
+    return Watchdog::threshold ? DBL2NUM(Watchdog::threshold) : Qnil;
+}
+
+// Starts the watchdog thread when set to the number of seconds a job may keep the reactor busy, nil stops it
+static VALUE Actuator_stall_threshold_set(VALUE klass, VALUE seconds)
+{
+    if (NIL_P(seconds)) {
+        Watchdog::Stop();
+    } else {
+        double stall_threshold = NUM2DBL(seconds);
+        if (stall_threshold <= 0) rb_raise(rb_eArgError, "stall threshold must be greater than 0");
+        Watchdog::Start(stall_threshold);
+    }
+    return seconds;
+}
+
+void Watchdog::Setup()
+{
+    rb_gc_register_address(&pending_stall);
+    offenders = rb_ary_new();
+    rb_gc_register_address(&offenders);
+#ifdef HAVE_RB_POSTPONED_JOB_PREREGISTER
+    capture_job = rb_postponed_job_preregister(0, capture_stall, 0);
+#endif
+
+    VALUE ActuatorClass = rb_define_module("Actuator");
+    rb_define_singleton_method(ActuatorClass, "stall_threshold", RUBY_METHOD_FUNC(Actuator_stall_threshold), 0);
+    rb_define_singleton_method(ActuatorClass, "stall_threshold=", RUBY_METHOD_FUNC(Actuator_stall_threshold_set), 1);
+}
+
+// Before ruby 3.3 postponed jobs could only be registered from ruby threads, the watchdog thread would crash the process
+bool Watchdog::IsSupported()
+{
+#ifdef HAVE_RB_POSTPONED_JOB_PREREGISTER
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Watchdog::Start(double stall_threshold)
+{
+    if (!IsSupported()) rb_raise(rb_eNotImpError, "the stall watchdog requires ruby 3.3 or later");
+    threshold = stall_threshold;
+    threshold_ns.store((int64_t)(stall_threshold * 1000000000));
+    if (thread) return;
+    is_stopping = false;
+    rb_add_event_hook(fiber_switch_hook, RUBY_EVENT_FIBER_SWITCH, Qnil);
+    thread = new std::thread(run);
+}
+
+void Watchdog::Stop()
+{
+    threshold = 0;
+    if (!thread) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        is_stopping = true;
+    }
+    stop_requested.notify_one();
+    thread->join();
+    delete thread;
+    thread = 0;
+    rb_remove_event_hook(fiber_switch_hook);
+}
+
+// Only the forking thread exists in a child, so the watchdog thread is abandoned rather than joined and its lock is
+// recreated in case the thread was holding it when the parent forked
+void Watchdog::AfterFork()
+{
+    bool was_running = thread != 0;
+    if (thread) {
+        thread = 0;
+        new (&mutex) std::mutex();
+        new (&stop_requested) std::condition_variable();
+        rb_remove_event_hook(fiber_switch_hook);
+    }
+    is_stopping = false;
+    stalled_since_ns.store(0);
+    pending_stall = Qnil;
+    rb_ary_clear(offenders);
+    stall_count = 0;
+    heartbeat.store(0);
+    is_idle.store(true);
+    if (was_running) Start(threshold);
+}
+
+// Called at the start of every reactor tick, stalls end once the reactor gets back to its loop
+void Watchdog::Tick()
+{
+    Beat();
+    if (NIL_P(pending_stall)) return;
+    int64_t stalled_since = stalled_since_ns.exchange(0);
+    double duration_ms = (steady_now_ns() - stalled_since) / 1000000.0;
+    VALUE stall = pending_stall;
+    pending_stall = Qnil;
+    rb_hash_aset(stall, ID2SYM(rb_intern("duration_ms")), DBL2NUM(duration_ms));
+    VALUE job_id = rb_hash_aref(stall, ID2SYM(rb_intern("job_id")));
+    Log::Warn("[Watchdog] Stall by job %s ended after %.1f ms", NIL_P(job_id) ? "-" : RSTRING_PTR(rb_obj_as_string(job_id)), duration_ms);
+
+    long index = RARRAY_LEN(offenders);
+    while (index > 0 && NUM2DBL(rb_hash_aref(rb_ary_entry(offenders, index - 1), ID2SYM(rb_intern("duration_ms")))) < duration_ms) index--;
+    if (index >= MaxOffenders) return;
+    rb_funcall(offenders, rb_intern("insert"), 2, LONG2NUM(index), stall);
+    if (RARRAY_LEN(offenders) > MaxOffenders) rb_ary_pop(offenders);
+}
+
+VALUE Watchdog::Stats()
+{
+    VALUE hash = rb_hash_new();
+    rb_hash_aset(hash, ID2SYM(rb_intern("supported")), IsSupported() ? Qtrue : Qfalse);
+    rb_hash_aset(hash, ID2SYM(rb_intern("enabled")), thread ? Qtrue : Qfalse);
+    rb_hash_aset(hash, ID2SYM(rb_intern("threshold_ms")), DBL2NUM(threshold * 1000));
+    rb_hash_aset(hash, ID2SYM(rb_intern("stalls")), ULL2NUM(stall_count));
+    rb_hash_aset(hash, ID2SYM(rb_intern("worst")), rb_ary_dup(offenders));
+    return hash;
+}
@@ -0,0 +1,34 @@
+#ifndef ACTUATOR_WATCHDOG_H
+#define ACTUATOR_WATCHDOG_H
+
+#include <stdint.h>
+#include <atomic>
+#include <ruby.h>
+
+// Optional native thread which detects jobs that keep the reactor busy for longer than the stall threshold.
+// The reactor only bumps a counter at every tick and fiber switch, the watchdog thread compares it against its own
+// clock and asks ruby to capture the backtrace of the stalled fiber through a postponed job.
+class Watchdog {
+public:
+    static const int MaxOffenders = 10;
+
+    static std::atomic<uint64_t> heartbeat;
+    static std::atomic<bool> is_idle;
+    static double threshold;
+    static uint64_t stall_count;
+
+    static void Setup();
+    static bool IsSupported();
+    static void Start(double stall_threshold);
+    static void Stop();
+    static void AfterFork();
+    static void Tick();
+    static VALUE Stats();
+
+    static inline void Beat()
+    {
+        heartbeat.store(heartbeat.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+#endif
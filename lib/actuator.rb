@@ -1,18 +1,22 @@
 require_relative 'actuator/actuator'
 require_relative 'actuator/job'
+require_relative 'actuator/job_group'
+require_relative 'actuator/offload'
 require_relative 'actuator/fiber'
 require_relative 'actuator/fiber_pool'
+require_relative 'actuator/fork'
 
 module Actuator
   VERSION = "0.0.5"
 
   class << self
-    def run
-      start { defer { yield } if block_given? }
+    # Options are passed to Actuator.start, see README for the supported real-time tuning options
+    def run(options=nil)
+      start(options) { defer { yield } if block_given? }
     end
 
     def next_tick
-      Timer.in(0) { yield }
+      Timer.after(0) { yield }
     end
 
     def defer
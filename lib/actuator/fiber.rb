@@ -1,7 +1,7 @@
 require 'fiber'
 
 class Fiber
-  attr_accessor :job, :last_job
+  attr_accessor :job, :last_job, :wake_timer
   attr_writer :is_root
 
   current.is_root = true
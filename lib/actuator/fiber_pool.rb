@@ -4,32 +4,105 @@ module Actuator
   class FiberPool
     MAX_FIBERS = 10000
 
+    # MRI doesn't support sizing individual fibers, stack sizes are set for the whole process with the
+    # RUBY_FIBER_VM_STACK_SIZE and RUBY_FIBER_MACHINE_STACK_SIZE environment variables before ruby starts
+    STACK_SIZE = RubyVM::DEFAULT_PARAMS[:fiber_vm_stack_size] + RubyVM::DEFAULT_PARAMS[:fiber_machine_stack_size]
+
     @fibers = []
     @idle_fibers = []
+    # Time each idle fiber was released, oldest first in the same order as @idle_fibers
+    @idle_since = []
     @queued_jobs = []
     @busy_count = 0
+    @created_count = 0
+    @evicted_count = 0
+    @idle_ttl = 30.0
+    @max_idle = MAX_FIBERS
+    @trim_at = nil
 
     class << self
-      attr_reader :busy_count
+      attr_reader :busy_count, :idle_ttl, :max_idle
+
+      # Idle fibers are freed once they haven't been used for idle_ttl seconds
+      def idle_ttl=(seconds)
+        @idle_ttl = seconds
+        @trim_at = nil
+        schedule_trim unless @idle_fibers.empty?
+      end
+
+      # Idle fibers above the watermark are freed, fibers released while the pool is full end instead
+      def max_idle=(count)
+        @max_idle = count
+        evict while @idle_fibers.size > @max_idle
+      end
+
+      # Memory is the address space reserved for fiber stacks, only the pages which have been touched are resident
+      def stats
+        {
+          busy: @busy_count,
+          idle: @idle_fibers.size,
+          queued: @queued_jobs.size,
+          created: @created_count,
+          evicted: @evicted_count,
+          stack_size: STACK_SIZE,
+          reserved_memory: (@busy_count + @idle_fibers.size) * STACK_SIZE,
+          idle_reserved_memory: @idle_fibers.size * STACK_SIZE
+        }
+      end
+
+      # Frees idle fibers which have outlived idle_ttl
+      def trim
+        @trim_at = nil
+        # Fibers within a millisecond of expiring are evicted as well, otherwise a rounding error can reschedule the
+        # trim for the current time over and over again (which never ends when using the virtual clock)
+        expires_before = Actuator.now - @idle_ttl + 0.001
+        evict while !@idle_since.empty? && @idle_since.first <= expires_before
+        schedule_trim unless @idle_fibers.empty?
+      end
+
+      # Frees every idle fiber, called when the reactor stops since the trim timer is released along with other timers
+      def evict_idle
+        evict until @idle_fibers.empty?
+        @trim_at = nil
+      end
+
+      # Jobs which were busy when the process forked are never resumed in the child, except the one which forked
+      def after_fork
+        evict_idle
+        @queued_jobs.clear
+        job = Fiber.current.job
+        @busy_count = job && !Fiber.current.root? ? 1 : 0
+        @created_count = @busy_count
+        @evicted_count = 0
+      end
 
       # Always starts fiber immediately - ignores MAX_FIBERS (can cause pool to grow beyond limit)
-      def run(whois=nil, &block)
+      def run(whois=nil, group=nil, &block)
         job = Job.new
         job.block = block
         job.whois = whois
+        # Jobs can end before run returns so they must join the group first
+        if group
+          job.group = group
+          group._add(job)
+        end
 
         @busy_count += 1
-        fiber = @idle_fibers.pop || create_new_fiber
+        fiber = acquire
         fiber.resume(job)
 
         job
       end
 
       # Job will be queued if MAX_FIBERS are already active
-      def queue(whois=nil, &block)
+      def queue(whois=nil, group=nil, &block)
         job = Job.new
         job.block = block
         job.whois = whois
+        if group
+          job.group = group
+          group._add(job)
+        end
 
         if @busy_count >= MAX_FIBERS
           @queued_jobs << job
@@ -38,13 +111,14 @@ module Actuator
         end
 
         @busy_count += 1
-        fiber = @idle_fibers.pop || create_new_fiber
+        fiber = acquire
         fiber.resume(job)
 
         job
       end
 
       def create_new_fiber
+        @created_count += 1
         Fiber.new do |job|
           fiber = Fiber.current
           while true
@@ -69,14 +143,49 @@ module Actuator
             if @queued_jobs.empty?
               @busy_count -= 1
               fiber.job = nil
-              @idle_fibers << fiber
+              # A fiber can't evict itself, so fibers above the watermark end instead of being released
+              if @idle_fibers.size >= @max_idle
+                @evicted_count += 1
+                break
+              end
+              release fiber
               job = Fiber.yield
+              # Evicted fibers are resumed without a job so that they end and their stacks are freed
+              break unless job
             else
               job = @queued_jobs.shift
             end
           end
         end
       end
+
+      private
+
+      def acquire
+        return create_new_fiber unless fiber = @idle_fibers.pop
+        @idle_since.pop
+        fiber
+      end
+
+      def release(fiber)
+        now = Actuator.now
+        @idle_fibers << fiber
+        @idle_since << now
+        # A pending trim can be left behind when the reactor is stopped
+        schedule_trim unless @trim_at && @trim_at > now
+      end
+
+      def evict
+        @idle_since.shift
+        @evicted_count += 1
+        @idle_fibers.shift.resume nil
+      end
+
+      def schedule_trim
+        @trim_at = @idle_since.first + @idle_ttl
+        @trim_timer ||= Timer.new { trim }
+        @trim_timer.reschedule(@trim_at - Actuator.now)
+      end
     end
   end
-end
\ No newline at end of file
+end
@@ -0,0 +1,38 @@
+require 'etc'
+
+module Actuator
+  # Process._fork is called for every fork (Kernel#fork, Process.fork, IO.popen with '-') since ruby 3.1
+  module ForkHook
+    def _fork
+      pid = super
+      Actuator.after_fork if pid == 0
+      pid
+    end
+  end
+  Process.singleton_class.prepend ForkHook if Process.respond_to?(:_fork)
+
+  class << self
+    # Resets the state a forked child inherits from its parent: timers, queues, stats, the clock baseline, log file
+    # handles, the metrics segment, the watchdog thread, fiber pool and offload workers. Called automatically in
+    # children on ruby 3.1+, older rubies need to call it at the start of the fork block.
+    def after_fork
+      _after_fork
+      FiberPool.after_fork
+      Offload.after_fork
+    end
+
+    # Pre-forks count workers which each run the block with their index, typically to start their own reactor. Each
+    # worker is pinned to one of the CPUs the process is allowed to run on unless affinity is false. Returns the pids
+    # of the workers.
+    def fork_workers(count, affinity: true)
+      raise "Workers must be forked before the reactor is started" if running?
+      cpus = allowed_cpus || Array.new(Etc.nprocessors) { |cpu| cpu }
+      Array.new(count) do |index|
+        Process.fork do
+          self.cpu_affinity = cpus[index % cpus.size] if affinity
+          yield index
+        end
+      end
+    end
+  end
+end
@@ -58,29 +58,40 @@ module Actuator
       end
 
       def sleep(seconds)
+        Job.current.sleep(seconds)
+      end
+
+      # Runs a blocking block on a worker thread and returns its result once it completes, see Offload
+      def offload(&block)
+        Offload.run(&block)
+      end
+
+      # Suspends the current job until the reactor has idle headroom, long running background jobs should
+      # call this whenever Actuator.idle_time_left runs out so that they only run in gaps between timers
+      def idle
         job = Job.current
-        job.sleep_timer = Timer.in(seconds) do
-          job.fiber.resume true
-        end
+        Actuator.idle { job.fiber.resume if job.alive? }
         Job.yield
-      ensure
-        job.sleep_timer = nil
       end
 
       def wait(jobs, timeout=nil)
         job = Job.current
         jobs << job
-        if timeout
-          job.sleep_timer = Timer.in(timeout) do
+        job.sleep_timer = job.wake_timer.reschedule(timeout) if timeout
+        begin
+          Job.yield
+        ensure
+          # The timer is still scheduled if the job was resumed before the timeout
+          if job.sleep_timer
+            job.sleep_timer.destroy
             job.sleep_timer = nil
-            job.fiber.resume true
           end
+          jobs.delete job
         end
-        Job.yield
       end
     end
 
-    attr_accessor :id, :block, :whois, :thread_locals, :system_thread_locals, :fiber, :sleep_timer, :mutex_asleep, :joined_on, :is_yielded, :resumed_at, :resumed_caller, :time_warning_started_at, :time_warning_extra, :time_warning_name
+    attr_accessor :id, :block, :whois, :group, :offloaded, :thread_locals, :system_thread_locals, :fiber, :sleep_timer, :mutex_asleep, :joined_on, :is_yielded, :resumed_at, :resumed_caller, :time_warning_started_at, :time_warning_extra, :time_warning_name
     attr_writer :thread_variables
 
     def job_started
@@ -99,6 +110,7 @@ module Actuator
         @joined_jobs = nil
         joined_jobs.each(&:resume)
       end
+      @group._job_ended(self) if @group
     end
 
     def yielded?
@@ -117,23 +129,44 @@ module Actuator
       @has_ended
     end
 
-    def sleep(seconds)
-      @sleep_timer = Timer.in(seconds) do
-        @sleep_timer = nil
+    # Sleeping, waiting and scheduling reschedule a single timer which is kept by the fiber, so suspending a job
+    # doesn't allocate once its pooled fiber has been used before
+    def wake_timer
+      @fiber.wake_timer ||= begin
+        fiber = @fiber
+        Timer.new do
+          # The fiber has no job if it was released to the pool while its timer was still scheduled
+          job = fiber.job
+          job.wake_timer_fired if job
+        end
+      end
+    end
+
+    def wake_timer_fired
+      @sleep_timer = nil
+      if @is_scheduled
+        @is_scheduled = false
+        @fiber.resume
+      else
         @fiber.resume true
       end
+    end
+
+    def sleep(seconds)
+      @sleep_timer = wake_timer.reschedule(seconds)
       Job.yield
+    ensure
+      # The timer is still scheduled if the job was resumed by something else
+      if @sleep_timer
+        @sleep_timer.destroy
+        @sleep_timer = nil
+      end
     end
 
     def schedule
       return if @is_scheduled
       @is_scheduled = true
-      @sleep_timer.destroy if @sleep_timer
-      @sleep_timer = Timer.in(0) do
-        @is_scheduled = false
-        @sleep_timer = nil
-        @fiber.resume
-      end
+      @sleep_timer = wake_timer.reschedule(0)
     end
 
     def wake!
@@ -195,6 +228,7 @@ module Actuator
       elsif @sleep_timer;   'asleep'
       elsif @mutex_asleep;  'mutex'
       elsif @joined_on;     "joined on job #{@joined_on.id}"
+      elsif @offloaded;     'offloaded'
       elsif @is_yielded;    'yielded'
       elsif !@fiber;        'missing fiber'
       elsif @fiber.alive?;  'alive'
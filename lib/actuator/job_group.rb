@@ -0,0 +1,94 @@
+module Actuator
+  # Tracks a set of jobs for fan-out/fan-in without joining each job separately. Jobs remove themselves from the
+  # group when they end and the waiting job is resumed once, either when the group is empty or when the wait times out.
+  class JobGroup
+    def initialize
+      # Hash so that ending jobs are removed in constant time while keeping the order they were deferred in
+      @jobs = {}
+      @waiter = nil
+      @wait_any = false
+      @ended_job = nil
+    end
+
+    def defer(whois=nil, &block)
+      FiberPool.run(whois, self, &block)
+    end
+
+    def size
+      @jobs.size
+    end
+
+    def empty?
+      @jobs.empty?
+    end
+
+    def jobs
+      @jobs.keys
+    end
+
+    # Returns true once every job in the group has ended or false if the timeout expired first
+    def wait_all(timeout=nil)
+      return true if @jobs.empty?
+      wait(false, timeout)
+      @jobs.empty?
+    end
+
+    # Returns the next job in the group to end, or nil if the group is empty or the timeout expired first
+    def wait_any(timeout=nil)
+      return if @jobs.empty?
+      wait(true, timeout)
+      ended_job = @ended_job
+      @ended_job = nil
+      ended_job
+    end
+
+    # Kills every job in the group, the current job is killed last if it is a member
+    def kill_all
+      current = Job.current
+      @jobs.keys.each {|job| job.kill unless job == current }
+      current.kill if @jobs.include? current
+      self
+    end
+
+    def _add(job)
+      @jobs[job] = true
+    end
+
+    def _job_ended(job)
+      @jobs.delete job
+      return unless waiter = @waiter
+      if @wait_any
+        @ended_job = job
+      else
+        return unless @jobs.empty?
+      end
+      @waiter = nil
+      if timer = waiter.sleep_timer
+        timer.destroy
+        waiter.sleep_timer = nil
+      end
+      waiter.fiber.resume
+    end
+
+    private
+
+    def wait(any, timeout)
+      raise "JobGroup already has a waiting job" if @waiter
+      job = Job.current
+      @waiter = job
+      @wait_any = any
+      job.sleep_timer = job.wake_timer.reschedule(timeout) if timeout
+      begin
+        Job.yield
+      ensure
+        @waiter = nil if @waiter == job
+        if job.sleep_timer
+          job.sleep_timer.destroy
+          job.sleep_timer = nil
+        end
+      end
+    end
+  end
+end
+
+JobGroup = Actuator::JobGroup
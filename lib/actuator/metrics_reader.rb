@@ -0,0 +1,85 @@
+module Actuator
+  # Samples the shared memory segment written by Actuator.publish_metrics from another process. Only depends on the
+  # standard library so that monitoring agents can use it without loading the extension.
+  class MetricsReader
+    MAGIC = 0x4D544341
+    VERSION = 1
+    SEQUENCE_OFFSET = 16
+    HEADER_FORMAT = 'L4Q2DQ5L8Q4Qq2L2'
+    HEADER_SIZE = 176
+    FIELDS = %i(magic version size pid sequence publish_count published_at wall_time_us frames empty_frames fires deferred
+                active_timers scheduled_timers timer_objects gc_registered fibers_busy fibers_idle jobs_queued padding
+                fibers_created fibers_evicted log_lines log_dropped lateness_count lateness_min lateness_max
+                lateness_bucket_count lateness_sub_bucket_bits)
+    MAX_RETRIES = 1000
+
+    attr_reader :path
+
+    # Segments published with the default name can be opened by pid
+    def self.path_for(pid_or_path)
+      pid_or_path.to_s =~ /\A\d+\z/ ? "/dev/shm/actuator.#{pid_or_path}" : pid_or_path.to_s
+    end
+
+    def initialize(pid_or_path)
+      @path = self.class.path_for(pid_or_path)
+      @file = File.open(@path, 'rb')
+      @size = nil
+    end
+
+    def close
+      @file.close
+    end
+
+    # Returns a consistent snapshot of the counters, retrying while the reactor is in the middle of publishing
+    def read
+      MAX_RETRIES.times do
+        @size ||= read_header_size
+        data = @file.pread(@size, 0)
+        sequence = data.unpack1('Q', offset: SEQUENCE_OFFSET)
+        next if sequence.odd?
+        next unless @file.pread(8, SEQUENCE_OFFSET).unpack1('Q') == sequence
+        return parse(data)
+      end
+      raise "Unable to read a consistent snapshot from #@path"
+    end
+
+    # Upper bound of a lateness histogram bucket in microseconds, see Histogram::BucketUpperBound
+    def self.bucket_upper_bound(index, sub_bucket_bits)
+      sub_bucket_count = 1 << sub_bucket_bits
+      return index if index < sub_bucket_count
+      shift = index / (sub_bucket_count / 2) - 1
+      sub_bucket = index % (sub_bucket_count / 2) + sub_bucket_count / 2
+      ((sub_bucket + 1) << shift) - 1
+    end
+
+    def self.percentile(snapshot, percentile)
+      count = snapshot[:lateness_count]
+      return 0 if count == 0
+      target = [(count * percentile / 100.0 + 0.5).to_i, 1].max
+      seen = 0
+      snapshot[:lateness_buckets].each_with_index do |bucket, index|
+        seen += bucket
+        next if seen < target
+        value = bucket_upper_bound(index, snapshot[:lateness_sub_bucket_bits])
+        return value < snapshot[:lateness_max] ? value : snapshot[:lateness_max]
+      end
+      snapshot[:lateness_max]
+    end
+
+    private
+
+    def read_header_size
+      magic, version, size = @file.pread(12, 0).unpack('L3')
+      raise "#@path is not an actuator metrics segment" unless magic == MAGIC
+      raise "#@path has metrics version #{version}, expected #{VERSION}" unless version == VERSION
+      size
+    end
+
+    def parse(data)
+      snapshot = FIELDS.zip(data.unpack(HEADER_FORMAT)).to_h
+      snapshot.delete :padding
+      snapshot[:lateness_buckets] = data.unpack("L#{snapshot[:lateness_bucket_count]}", offset: HEADER_SIZE)
+      snapshot
+    end
+  end
+end
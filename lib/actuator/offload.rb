@@ -0,0 +1,73 @@
+module Actuator
+  # Bounded pool of worker threads for blocking calls (DNS lookups, blocking C extensions, legacy clients) which would
+  # otherwise freeze the reactor. Workers are started on demand up to max_threads, requests queue once they are all busy.
+  # Results are posted back to the reactor thread with Actuator.post which wakes the reactor if it is sleeping.
+  module Offload
+    @max_threads = 4
+    @threads = []
+    @requests = Thread::Queue.new
+    @idle_count = 0
+    @completed_count = 0
+
+    class << self
+      attr_accessor :max_threads
+
+      # Runs the block on a worker thread and suspends the current job until it completes, exceptions are re-raised in the job
+      def run(&block)
+        job = Job.current
+        start_worker if @idle_count == 0 && @threads.size < @max_threads
+        request = [job, block, nil, nil]
+        @requests << request
+        job.offloaded = true
+        begin
+          Job.yield
+        ensure
+          job.offloaded = false
+        end
+        raise request[3] if request[3]
+        request[2]
+      end
+
+      def stats
+        { threads: @threads.size, busy: @threads.size - @idle_count, queued: @requests.size, completed: @completed_count }
+      end
+
+      # Worker threads don't survive a fork, requests queued by the parent are left to it
+      def after_fork
+        @threads = []
+        @requests = Thread::Queue.new
+        @idle_count = 0
+        @completed_count = 0
+      end
+
+      private
+
+      def start_worker
+        @threads << Thread.new do
+          Thread.current.name = 'actuator-offload'
+          while true
+            @idle_count += 1
+            request = @requests.pop
+            @idle_count -= 1
+            begin
+              request[2] = request[1].call
+            rescue Exception => ex
+              request[3] = ex
+            end
+            complete request
+          end
+        end
+      end
+
+      # The request is a method argument so that the posted block doesn't capture the worker's next request
+      def complete(request)
+        Actuator.post do
+          @completed_count += 1
+          job = request[0]
+          # Killed jobs aren't resumed, the result is dropped
+          job.fiber.resume if job.alive?
+        end
+      end
+    end
+  end
+end
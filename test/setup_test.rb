@@ -2,6 +2,7 @@ require 'minitest'
 require 'minitest/autorun'
 
 require_relative '../lib/actuator'
+require_relative '../lib/actuator/metrics_reader'
 
 module Minitest
   class << self
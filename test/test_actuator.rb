@@ -44,6 +44,530 @@ module Actuator
       end
     end
 
+    def test_lateness_histogram
+      Timer.reset_lateness
+      assert Timer.lateness[:count] == 0, 'Timer.reset_lateness did not clear the histogram'
+      timers = Array.new(10) { Timer.in(0.001) {} }
+      assert_async do
+        Kernel.sleep 0.05
+        lateness = Timer.lateness
+        assert timers.all?(&:destroyed?), 'timers did not fire within 50ms'
+        assert lateness[:count] == 10, "histogram recorded #{lateness[:count]} / 10 fires"
+        assert lateness[:p50] <= lateness[:p99] && lateness[:p99] <= lateness[:max], "percentiles are not ordered: #{lateness.inspect}"
+      end
+    end
+
+    def test_gc_lateness_attribution
+      gc_late_fires = Actuator.stats[:gc][:late_fires]
+      fired = false
+      scheduled_at = Actuator.now
+      Timer.in(0.0005) { fired = true }
+      # Block the reactor until the timer has expired so that the GC pause happens while it is waiting to fire
+      nil while Actuator.now < scheduled_at + 0.001
+      GC.start
+      Job.sleep 0.01
+      assert fired, 'timer did not fire after GC'
+      assert Actuator.stats[:gc][:late_fires] > gc_late_fires, 'late fire during GC pause was not attributed to GC'
+    end
+
+    def test_priority_lanes_and_tick_budget
+      order = []
+      deferred = Actuator.stats[:timers][:deferred]
+      Timer.tick_budget_us = 1000
+      low_timers = Array.new(100) do |i|
+        Timer.in(0.001, :low) do
+          started_at = Actuator.now
+          nil while Actuator.now < started_at + 0.0001
+          order << i
+        end
+      end
+      high_timer = Timer.in(0.001, :high) { order << :high }
+      assert high_timer.priority == :high, 'Timer#priority did not return the priority passed to Timer.in'
+      # Block the reactor until every timer has expired so that they all expire in the same tick
+      scheduled_at = Actuator.now
+      nil while Actuator.now < scheduled_at + 0.002
+      Job.sleep 0.1
+      assert order.first == :high, 'high priority timer did not fire before low priority timers which expired in the same tick'
+      assert low_timers.all?(&:destroyed?), 'low priority timers were not carried over until they fired'
+      assert order.size == 101, "only #{order.size} / 101 timers fired"
+      assert Actuator.stats[:timers][:deferred] > deferred, 'timers were not deferred after the tick budget was exceeded'
+    ensure
+      Timer.tick_budget_us = 0
+    end
+
+    def test_carried_timer_rescheduled_into_the_future
+      Timer.tick_budget_us = 1000
+      fired_at = {}
+      timers = Array.new(4) do |i|
+        Timer.in(0.001, :low) do
+          fired_at[i] = Actuator.now
+          # Exceeds the budget so that every tick fires a single timer and carries the rest over
+          started_at = Actuator.now
+          nil while Actuator.now < started_at + 0.002
+          timers[1].reschedule(1) if i == 0
+        end
+      end
+      Job.sleep 0.1
+      timers[1].destroy
+      assert fired_at.keys.sort == [0, 2, 3], "fired #{fired_at.keys.sort.inspect}"
+      # The reactor must not sleep until the rescheduled timer at the front of the lane while the rest are overdue
+      assert fired_at[2] - fired_at[0] < 0.025, "carried timer fired #{((fired_at[2] - fired_at[0]) * 1000).round} ms after the previous tick"
+    ensure
+      Timer.tick_budget_us = 0
+    end
+
+    def test_destroy_rescheduled_expired_timer
+      objects = nil
+      later = nil
+      first = Timer.in(0.001) do
+        # The later timer has expired in the same tick and is still waiting in its lane
+        later.reschedule(1)
+        later.destroy
+        later = nil
+        objects = Actuator.stats[:timers][:objects]
+        GC.start
+        objects -= Actuator.stats[:timers][:objects]
+      end
+      later = Timer.in(0.001) {}
+      started_at = Actuator.now
+      nil while Actuator.now < started_at + 0.002
+      Job.sleep 0.01
+      assert first.destroyed?
+      assert objects == 0, 'timer waiting in its lane was freed by the GC after being destroyed'
+    end
+
+    def test_idle_queue
+      order = []
+      time_left = nil
+      Timer.in(0.0005) { order << :timer }
+      Actuator.idle do
+        order << :idle
+        time_left = Actuator.idle_time_left
+      end
+      idle_job = Actuator.defer do
+        3.times { Job.idle }
+        order << :idle_job
+      end
+      Job.sleep 0.01
+      assert order.first == :timer, 'idle task ran while a timer was due within the idle margin'
+      assert order.include?(:idle), 'idle task never ran'
+      assert time_left > 0 && time_left <= Actuator.idle_slice, "idle task was given a #{time_left} second slice"
+      assert !idle_job.alive?, 'job did not finish after yielding with Job.idle'
+      assert Actuator.idle_time_left == 0, 'idle time left outside of an idle task'
+    end
+
+    def test_fire_and_forget_timer
+      called = called2 = 0
+      objects = Actuator.stats[:timers][:objects]
+      handle = Timer.after(0.001) { called += 1 }
+      handle2 = Timer.after(0.001) { called2 += 1 }
+      assert handle.is_a?(Integer), 'Timer.after did not return an integer handle'
+      assert Actuator.stats[:timers][:objects] == objects, 'Timer.after allocated a ruby timer instance'
+      assert Timer.cancel(handle2), 'Timer.cancel did not cancel a scheduled timer'
+      # Callbacks of pooled timers are only referenced by the pool
+      GC.start
+      Job.sleep 0.01
+      assert called == 1, 'fire-and-forget timer callback not called'
+      assert called2 == 0, 'fire-and-forget timer callback called after being cancelled'
+      assert !Timer.cancel(handle), 'Timer.cancel returned true for a timer which already fired'
+      reused = Timer.after(1) {}
+      assert !Timer.cancel(handle2), 'stale handle cancelled the timer which reused its slot'
+      assert Timer.cancel(reused)
+    end
+
+    def test_method_call_timer
+      calls = []
+      receiver = Object.new
+      receiver.define_singleton_method(:on_timeout) {|*args| calls << args }
+      Timer.call_in(0.001, receiver, :on_timeout, 'conn', 2)
+      Timer.call_in(0.001, receiver, :on_timeout)
+      Timer.cancel(Timer.call_in(0.001, receiver, :on_timeout, :cancelled))
+      assert_raises(ArgumentError) { Timer.call_in(0.001, receiver, :on_timeout, 1, 2, 3, 4) }
+      GC.start
+      Job.sleep 0.01
+      assert calls == [['conn', 2], []], "method call timers fired with #{calls.inspect}"
+    end
+
+    def test_reschedule_timer
+      fired = 0
+      timer = Timer.in(0.002) { fired += 1 }
+      expires_at = timer.expires_at
+      timer.postpone(0.001)
+      assert_in_delta expires_at + 0.001, timer.expires_at, 0.000001
+      timer.reschedule(0.05)
+      Job.sleep 0.01
+      assert fired == 0, 'timer fired at the original time after being rescheduled'
+      timer.reset
+      Job.sleep 0.01
+      assert fired == 1, 'timer did not fire after being reset'
+      assert timer.destroyed?
+      # Expired and destroyed timers are scheduled again
+      timer.reschedule(0.001)
+      assert !timer.destroyed?
+      Job.sleep 0.01
+      assert fired == 2, 'expired timer did not fire after being rescheduled'
+      ticks = 0
+      interval = Timer.every(0.001) { ticks += 1; interval.reschedule(0.05) if ticks == 2 }
+      Job.sleep 0.02
+      assert ticks == 2, "interval timer fired #{ticks} times after being rescheduled from its own callback"
+      interval.destroy
+      objects = Actuator.stats[:timers][:objects]
+      3.times { Job.sleep 0.001 }
+      assert Actuator.stats[:timers][:objects] == objects, 'Job.sleep allocated a new timer'
+    end
+
+    def test_timer_group
+      group = TimerGroup.new(0.02, 0.02, 4)
+      first_fired_at = {}
+      counts = Array.new(20, 0)
+      started_at = Actuator.now
+      members = 20.times.map do |i|
+        group.every { counts[i] += 1; first_fired_at[i] ||= Actuator.now - started_at }
+      end
+      assert group.size == 20
+      assert_raises(RuntimeError) { members[0].reschedule(0.01) }
+      Job.sleep 0.015
+      assert first_fired_at.size.between?(5, 19), "#{first_fired_at.size} members fired within the first 15ms, phases were not spread"
+      members[1].destroy
+      assert members[1].destroyed?
+      assert group.size == 19
+      Job.sleep 0.1
+      assert counts[0].between?(4, 6), "member fired #{counts[0]} times in 115ms with a 20ms period"
+      assert counts[1] < 2, 'member fired after being destroyed'
+      # Members can leave from their own callback
+      leaving = group.every { leaving.destroy }
+      Job.sleep 0.03
+      assert leaving.destroyed?
+      members.each(&:destroy)
+      assert group.size == 0
+      fired = counts.sum
+      Job.sleep 0.03
+      assert counts.sum == fired, 'members fired after the group was emptied'
+    end
+
+    def test_metrics_segment
+      path = Actuator.publish_metrics("actuator-test.#{Process.pid}", 0)
+      assert File.exist?(path), "metrics segment was not created at #{path}"
+      reader = MetricsReader.new(path)
+      before = reader.read
+      assert before[:pid] == Process.pid
+      timer = Timer.every(0.001) {}
+      Job.sleep 0.05
+      after = reader.read
+      timer.destroy
+      assert after[:publish_count] > before[:publish_count], 'segment was not updated by the reactor'
+      assert after[:fires] - before[:fires] >= 10, "only #{after[:fires] - before[:fires]} fires published in 50ms"
+      assert after[:frames] > before[:frames]
+      assert after[:fibers_busy] >= 1, 'running job not included in fiber pool occupancy'
+      assert after[:lateness_count] == after[:lateness_buckets].sum
+      assert MetricsReader.percentile(after, 99) <= after[:lateness_max]
+    ensure
+      Actuator.unpublish_metrics
+      reader.close if reader
+      assert !File.exist?(path), 'metrics segment was not removed' if path
+    end
+
+    def test_stall_watchdog
+      skip 'the stall watchdog requires ruby 3.3' unless Actuator.stats[:watchdog][:supported]
+      stalls = Actuator.stats[:watchdog][:stalls]
+      Actuator.stall_threshold = 0.03
+      Job.sleep 0.05
+      assert Actuator.stats[:watchdog][:stalls] == stalls, 'idle reactor reported as stalled'
+      stalled_job = FiberPool.run('stalling job') do
+        started_at = Actuator.now
+        nil while Actuator.now < started_at + 0.1
+      end
+      Job.sleep 0.01
+      stats = Actuator.stats[:watchdog]
+      assert stats[:stalls] == stalls + 1, "#{stats[:stalls] - stalls} stalls reported for a single 100ms stall"
+      stall = stats[:worst].find {|worst| worst[:job_id] == stalled_job.id }
+      assert stall, 'stalled job not in the worst offenders'
+      assert stall[:whois] == 'stalling job'
+      assert stall[:duration_ms] >= 90, "stall duration was #{stall[:duration_ms]} ms"
+      assert stall[:backtrace].any? {|line| line.include? __FILE__ }, 'backtrace does not include the stalled block'
+    ensure
+      Actuator.stall_threshold = nil
+    end
+
+    # The reactor can't be stopped from within a test, so the restarts run in a separate process
+    def test_teardown_on_stop
+      script = <<~RUBY
+        require_relative #{File.expand_path('../lib/actuator', __dir__).inspect}
+        group = TimerGroup.new(10)
+        runs = Array.new(10) do
+          Actuator.run do
+            100.times { Timer.in(10) {}; Timer.every(10) {}; Timer.after(10) {}; group.every {} }
+            Actuator.idle {}
+            Timer.in(0.001) { Actuator.stop }
+          end
+          GC.start
+          [Actuator.memory_stats[:total], Actuator.stats[:timers].values_at(:scheduled, :pooled, :gc_registered), group.size, Actuator::FiberPool.stats[:idle]]
+        end
+        print Marshal.dump(runs)
+      RUBY
+      runs = Marshal.load(Job.offload { IO.popen([RbConfig.ruby, '-e', script], &:read) })
+      assert runs.size == 10, 'restart script did not complete'
+      runs.each do |memory, (scheduled, pooled, gc_registered), group_size, idle_fibers|
+        assert scheduled == 0 && pooled == 0 && gc_registered == 0, 'timers left behind after Actuator.stop'
+        assert group_size == 0, 'timer group members left behind after Actuator.stop'
+        assert idle_fibers == 0, 'idle fibers left behind after Actuator.stop'
+        assert memory == runs.first.first, "native memory grew from #{runs.first.first} to #{memory} bytes between runs"
+      end
+    end
+
+    def test_teardown_on_exception
+      script = <<~RUBY
+        require_relative #{File.expand_path('../lib/actuator', __dir__).inspect}
+        Log.file_path = File::NULL
+        runs = Array.new(3) do
+          [Timer.method(:every), Timer.method(:after)].map do |schedule|
+            begin
+              Actuator.run { 10.times { Timer.in(10) {} }; schedule.(0.001) { raise 'callback failed' } }
+            rescue RuntimeError
+            end
+            GC.start
+            [Actuator.running?, Actuator.memory_stats[:timer_pool], Actuator.stats[:timers].values_at(:scheduled, :pooled, :gc_registered)]
+          end
+        end
+        fired = false
+        Actuator.run { Timer.in(0.001) { fired = true; Actuator.stop } }
+        print Marshal.dump([runs.flatten(1), fired])
+      RUBY
+      runs, fired = Marshal.load(Job.offload { IO.popen([RbConfig.ruby, '-e', script], &:read) })
+      assert runs.size == 6, 'restart script did not complete'
+      runs.each do |running, pool_memory, timers|
+        assert !running, 'reactor was left running after a callback raised'
+        assert pool_memory == 0, 'timer pool kept its slabs after a callback raised'
+        assert timers == [0, 0, 0], "timers left behind after a callback raised: #{timers.inspect}"
+      end
+      assert fired, 'reactor could not be restarted after a callback raised'
+    end
+
+    def test_fork_resets_reactor
+      script = <<~RUBY
+        require_relative #{File.expand_path('../lib/actuator', __dir__).inspect}
+        results = {}
+        child = nil
+        reader, writer = IO.pipe
+        Actuator.run(prefault_stack: true) do
+          Actuator.publish_metrics "actuator-fork-test.\#{Process.pid}"
+          100.times { Timer.in(10) {} }
+          # Forks from a pooled timer callback, the child returns to the reactor loop which stops and tears it down
+          Timer.after(0.01) do
+            if pid = fork
+              writer.close
+              results[:child] = Marshal.load(reader)
+              Process.wait pid
+              results[:metrics_path] = Actuator.metrics_path
+              Actuator.unpublish_metrics
+              Actuator.stop
+            else
+              child = Actuator.running?
+            end
+          end
+        end
+        unless child.nil?
+          state = [child, Actuator.stats[:timers][:scheduled], Actuator.now, Actuator.metrics_path, Actuator::FiberPool.busy_count,
+                   Actuator.stats[:realtime][:prefault_stack]]
+          writer.write Marshal.dump(state)
+          exit!
+        end
+        reader, writer = IO.pipe
+        pids = Actuator.fork_workers(2) do |index|
+          fires = 0
+          Actuator.run do
+            Timer.every(0.001) { fires += 1 }
+            Timer.in(0.05) { Actuator.stop }
+          end
+          writer.write Marshal.dump([index, fires, Actuator.stats[:realtime][:affinity]])
+          exit!
+        end
+        writer.close
+        pids.each { |pid| Process.wait pid }
+        results[:workers] = Array.new(pids.size) { Marshal.load(reader) }.sort
+        print Marshal.dump(results)
+      RUBY
+      skip 'fork is not supported' unless Process.respond_to?(:fork)
+      results = Marshal.load(Job.offload { IO.popen([RbConfig.ruby, '-e', script], &:read) })
+      running, scheduled, now, metrics_path, busy, prefault_stack = results[:child]
+      assert !running, 'forked child kept running the reactor of its parent'
+      assert scheduled == 0, "forked child inherited #{scheduled} scheduled timers"
+      assert now < 0.01, "forked child clock was not re-baselined (#{now})"
+      assert metrics_path.nil?, 'forked child kept the metrics segment of its parent'
+      assert busy == 0, "forked child fiber pool counted #{busy} busy fibers of its parent"
+      assert prefault_stack == :not_requested, 'forked child reported real-time tuning applied by its parent'
+      assert results[:metrics_path], 'forked child closed the metrics segment of its parent'
+      assert results[:workers].map(&:first) == [0, 1], 'fork_workers did not run every worker'
+      results[:workers].each do |index, fires, affinity|
+        assert fires >= 10, "worker #{index} only fired #{fires} timers"
+        # Workers are pinned to the CPUs the test process is allowed to run on, whichever ids those are
+        assert affinity == :applied, "worker #{index} was not pinned to an allowed CPU (#{affinity})" if Actuator.allowed_cpus
+      end
+    end
+
+    def test_invalid_start_options
+      script = <<~RUBY
+        require_relative #{File.expand_path('../lib/actuator', __dir__).inspect}
+        error = begin
+          Actuator.run(scheduler: :bogus) {}
+        rescue ArgumentError => ex
+          ex.class
+        end
+        fired = false
+        # Larger than any stack, prefaulting is clamped to the stack which is left and a warning is logged
+        Log.file_path = File::NULL
+        Actuator.run(prefault_stack: 1 << 40) { Timer.in(0.001) { fired = true; Actuator.stop } }
+        print Marshal.dump([error, fired])
+      RUBY
+      error, fired = Marshal.load(Job.offload { IO.popen([RbConfig.ruby, '-e', script], &:read) })
+      assert error == ArgumentError, 'invalid start options did not raise'
+      assert fired, 'reactor could not be started again after invalid start options'
+    end
+
+    def test_fiber_pool_eviction
+      ttl = FiberPool.idle_ttl
+      evicted = FiberPool.stats[:evicted]
+      50.times { Actuator.defer { Job.sleep 0.001 } }
+      Job.sleep 0.005
+      stats = FiberPool.stats
+      assert stats[:idle] >= 50, "finished jobs did not return #{50 - stats[:idle]} fibers to the pool"
+      assert stats[:idle_reserved_memory] == stats[:idle] * stats[:stack_size]
+      FiberPool.idle_ttl = 0.005
+      Job.sleep 0.02
+      stats = FiberPool.stats
+      assert stats[:idle] == 0, "#{stats[:idle]} idle fibers were not evicted after the ttl"
+      assert stats[:evicted] - evicted >= 50
+      FiberPool.idle_ttl = ttl
+      max_idle = FiberPool.max_idle
+      FiberPool.max_idle = 10
+      50.times { Actuator.defer { Job.sleep 0.001 } }
+      Job.sleep 0.005
+      assert FiberPool.stats[:idle] == 10, 'idle fibers above the watermark were not evicted'
+      FiberPool.max_idle = 0
+      evicted = FiberPool.stats[:evicted]
+      10.times { Actuator.defer { Job.sleep 0.001 } }
+      Job.sleep 0.005
+      stats = FiberPool.stats
+      assert stats[:idle] == 0, 'fibers were released to a pool without room for idle fibers'
+      assert stats[:evicted] - evicted == 10
+      FiberPool.max_idle = max_idle
+    end
+
+    def test_virtual_clock
+      scenario = lambda do
+        events = []
+        started_at = Actuator.now
+        record = ->(name) { events << [name, ((Actuator.now - started_at) * 100).round] }
+        Timer.in(0.06) { record.(:once) }
+        3.times {|i| Timer.in(0.14) { record.(:"same_deadline_#{i}") } }
+        retry_timer = Timer.in(0.02) { record.(:retry) }
+        retry_timer.postpone(0.16)
+        interval = Timer.every(0.04) { record.(:interval) }
+        Actuator.defer { Job.sleep 0.1; record.(:job) }
+        Job.sleep 0.22
+        interval.destroy
+        events
+      end
+      real_events = scenario.call
+      Actuator.virtual_clock = true
+      begin
+        virtual_events = scenario.call
+        # A day of timers replays without waiting
+        fired = 0
+        started_at = Actuator.now
+        timer = Timer.every(60) { fired += 1 }
+        Job.sleep 86430
+        timer.destroy
+        assert fired == 1440, "interval fired #{fired} times in a virtual day"
+        assert_in_delta 86430, Actuator.now - started_at, 1
+      ensure
+        Actuator.virtual_clock = false
+      end
+      assert virtual_events.map(&:first) == real_events.map(&:first), "virtual run #{virtual_events.inspect} does not match real run #{real_events.inspect}"
+      assert virtual_events == [[:interval, 4], [:once, 6], [:interval, 8], [:job, 10], [:interval, 12], [:same_deadline_0, 14],
+        [:same_deadline_1, 14], [:same_deadline_2, 14], [:interval, 16], [:retry, 18], [:interval, 20]], "virtual run fired at #{virtual_events.inspect}"
+    end
+
+    def test_virtual_clock_option
+      script = <<~RUBY
+        require_relative #{File.expand_path('../lib/actuator', __dir__).inspect}
+        Actuator.run(virtual_clock: true) { Timer.in(86400) { Actuator.stop } }
+        virtual = Actuator.virtual_clock?
+        elapsed = nil
+        Actuator.run do
+          started_at = Actuator.now
+          Timer.in(0.02) { elapsed = Actuator.now - started_at; Actuator.stop }
+        end
+        path = File.join(Dir.tmpdir, "actuator_clock_\#{Process.pid}.log")
+        Log.file_path = path
+        Log.puts 'after a virtual day'
+        Log.file_path = :stdout
+        logged_at = File.read(path).to_f / 1000
+        File.delete path
+        print Marshal.dump([virtual, elapsed, Actuator.now, logged_at])
+      RUBY
+      virtual, elapsed, now, logged_at = Marshal.load(Job.offload { IO.popen([RbConfig.ruby, '-rtmpdir', '-e', script], &:read) })
+      assert !virtual, 'virtual_clock start option outlived the run'
+      assert elapsed >= 0.02, "clock only moved #{elapsed} seconds in the next real time run"
+      assert now >= 86400, 'Actuator.now went backwards after leaving the virtual clock'
+      assert logged_at < 3600, "log timestamp #{logged_at} includes the simulated day"
+    end
+
+    def test_job_group
+      group = JobGroup.new
+      jobs = [0.004, 0.001, 0.002].map {|delay| group.defer { Job.sleep delay } }
+      group.defer {}
+      assert group.size == 3, 'job which ended immediately was not removed from the group'
+      assert group.wait_any == jobs[1], 'wait_any did not return the first job to end'
+      assert group.wait_all(0.0005) == false, 'wait_all did not time out'
+      resumed = 0
+      Actuator.defer { group.wait_all; resumed += 1 }
+      Job.sleep 0.01
+      assert group.empty?
+      assert resumed == 1, "waiter was resumed #{resumed} times"
+      assert group.wait_all(0.001), 'wait_all on an empty group did not return immediately'
+      killed = []
+      3.times {|i| group.defer { begin; Job.sleep 1; ensure; killed << i; end } }
+      group.kill_all
+      assert killed.sort == [0, 1, 2] && group.empty?, 'kill_all did not kill every job in the group'
+    end
+
+    def test_job_wait_timeout
+      waiters = []
+      results = []
+      job = Actuator.defer { results << Job.wait(waiters, 0.005) }
+      Actuator.next_tick { waiters.shift.fiber.resume :woken }
+      Job.sleep 0.001
+      assert results == [:woken], 'waiting job was not resumed'
+      assert job.ended? && !job.asleep?, 'wait timeout was left scheduled after the job was resumed'
+      # The fiber is back in the pool without a job, its timer must not fire into it
+      Job.sleep 0.01
+      results.clear
+      assert Job.wait(waiters, 0.001) == true, 'wait did not time out'
+      assert waiters.empty?, 'job which timed out was left in the waiters'
+    end
+
+    def test_offload
+      reactor_thread = Thread.current
+      ticks = 0
+      timer = Timer.every(0.001) { ticks += 1 }
+      result = Job.offload do
+        Kernel.sleep 0.05
+        Thread.current == reactor_thread ? :reactor : :worker
+      end
+      timer.destroy
+      assert result == :worker, 'offloaded block did not run on a worker thread'
+      assert ticks > 10, "reactor only ticked #{ticks} times while the offloaded block was blocking"
+      error = assert_raises(ArgumentError) { Job.offload { raise ArgumentError, 'offloaded' } }
+      assert error.message == 'offloaded'
+      group = JobGroup.new
+      results = []
+      8.times {|i| group.defer { results << Job.offload { Kernel.sleep 0.01; i } } }
+      group.wait_all
+      assert results.sort == (0...8).to_a
+      assert Offload.stats[:threads] <= Offload.max_threads
+    end
+
     #TODO: Implement sampling in the C++ extension to eliminate profiling overhead
     def test_timer_precision
       fiber = Fiber.current